@@ -0,0 +1,264 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Headless frame benchmark: runs Debug::draw against a private mpv instance,
+// renders with the software rasterizer and reports frame times. The last
+// frame can be saved or compared against a reference image.
+//
+//   debug-bench [--size WxH] [--frames N] [--logs N] [--log-rate N] [--file URL]
+//               [--closed] [--out image.ppm] [--compare ref.ppm] [--tolerance F]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include <imgui.h>
+#include <imgui_internal.h>
+#include <mpv/client.h>
+#include "debug.h"
+#include "main.h"
+#include "memory.h"
+#include "raster.h"
+
+struct Options {
+    int width = 1280;
+    int height = 960;
+    int frames = 300;
+    int logs = 5000;
+    int logRate = 20;
+    bool open = true;
+    std::string file;
+    std::string out;
+    std::string compare;
+    double tolerance = 0;
+};
+
+static const char *levels[] = {"error", "warn", "info", "status", "v", "debug"};
+static const char *modules[] = {"cplayer", "vd", "ad", "ffmpeg", "demux", "vo/gpu", "ao/pipewire", "osd/libass"};
+
+// deterministic log lines with a mix of levels, modules, lengths and repeats
+static void addLogs(Debug *debug, int count, int &seq) {
+    for (int i = 0; i < count; i++, seq++) {
+        int n = seq > 0 && seq % 97 == 0 ? seq - 1 : seq;  // some exact repeats for collapsing
+        auto text = fmt::format("synthetic message {} {}\n", n, std::string(n % 7 * 12, 'x'));
+        debug->AddLog(modules[n % IM_ARRAYSIZE(modules)], levels[n % IM_ARRAYSIZE(levels)], text.c_str());
+    }
+}
+
+static void pumpEvents(mpv_handle *mpv, Debug *debug) {
+    while (true) {
+        mpv_event *event = mpv_wait_event(mpv, 0);
+        switch (event->event_id) {
+            case MPV_EVENT_NONE:
+                debug->handleEvent(event);
+                return;
+            case MPV_EVENT_PROPERTY_CHANGE:
+                if (event->reply_userdata == 0)
+                    debug->update((mpv_event_property *)event->data);
+                else
+                    debug->handleEvent(event);
+                break;
+            case MPV_EVENT_LOG_MESSAGE: {
+                auto msg = (mpv_event_log_message *)event->data;
+                debug->AddLog(msg->prefix, msg->level, msg->text);
+                break;
+            }
+            case MPV_EVENT_COMMAND_REPLY:
+            case MPV_EVENT_PLAYBACK_RESTART:
+            case MPV_EVENT_END_FILE:
+                debug->handleEvent(event);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// opens the collapsed sections; their labels carry the row counts, which
+// are read back from mpv the same way the tables are built
+static void openSections(mpv_handle *mpv) {
+    ImGuiWindow *window = ImGui::FindWindowByName("Debug");
+    if (window == nullptr) return;
+    auto count = [&](const char *name) {
+        mpv_node node{0};
+        int n = 0;
+        if (mpv_get_property(mpv, name, MPV_FORMAT_NODE, &node) >= 0 && node.format == MPV_FORMAT_NODE_ARRAY)
+            n = node.u.list->num;
+        mpv_free_node_contents(&node);
+        return n;
+    };
+    std::string labels[] = {
+        fmt::format("Options [{}]", count("options")),
+        fmt::format("Properties [{}]", count("property-list")),
+        fmt::format("Bindings [{}]", count("input-bindings")),
+        fmt::format("Commands [{}]", count("command-list")),
+        "Memory",
+    };
+    for (auto &label : labels) window->StateStorage.SetInt(ImHashStr(label.c_str(), 0, window->ID), 1);
+}
+
+static void printTimes(const char *name, std::vector<double> &ms) {
+    if (ms.empty()) return;
+    std::sort(ms.begin(), ms.end());
+    double sum = 0;
+    for (double v : ms) sum += v;
+    auto pct = [&](double p) { return ms[std::min(ms.size() - 1, (size_t)std::ceil(p * ms.size()) - 1)]; };
+    printf("%-8s p50=%.3f p90=%.3f p99=%.3f max=%.3f mean=%.3f ms\n", name, pct(0.5), pct(0.9), pct(0.99), ms.back(),
+           sum / ms.size());
+}
+
+// share of pixels whose channels differ by more than a small rounding slack
+static double compareImages(const Image &a, const Image &b, Image &diff) {
+    diff = a;
+    size_t bad = 0;
+    for (size_t i = 0; i < a.pixels.size(); i++) {
+        uint32_t p = a.pixels[i], q = b.pixels[i];
+        int delta = 0;
+        for (int shift = 0; shift < 24; shift += 8)
+            delta = std::max(delta, std::abs((int)((p >> shift) & 0xff) - (int)((q >> shift) & 0xff)));
+        if (delta > 2) bad++;
+        diff.pixels[i] = delta > 2 ? 0xff0000ff : (p & 0xfefefe) >> 1 | 0xff000000;
+    }
+    return a.pixels.empty() ? 0 : (double)bad / a.pixels.size();
+}
+
+static bool parseArgs(int argc, char **argv, Options &opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--closed") {
+            opts.open = false;
+            continue;
+        }
+        if (value == nullptr) return false;
+        i++;
+        if (arg == "--size") {
+            if (sscanf(value, "%dx%d", &opts.width, &opts.height) != 2) return false;
+        } else if (arg == "--frames") {
+            opts.frames = atoi(value);
+        } else if (arg == "--logs") {
+            opts.logs = atoi(value);
+        } else if (arg == "--log-rate") {
+            opts.logRate = atoi(value);
+        } else if (arg == "--file") {
+            opts.file = value;
+        } else if (arg == "--out") {
+            opts.out = value;
+        } else if (arg == "--compare") {
+            opts.compare = value;
+        } else if (arg == "--tolerance") {
+            opts.tolerance = atof(value);
+        } else {
+            return false;
+        }
+    }
+    return opts.width > 0 && opts.height > 0 && opts.frames > 0;
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        fprintf(stderr,
+                "usage: %s [--size WxH] [--frames N] [--logs N] [--log-rate N] [--file URL] [--closed]\n"
+                "          [--out image.ppm] [--compare ref.ppm] [--tolerance F]\n",
+                argv[0]);
+        return 2;
+    }
+
+    mpv_handle *mpv = mpv_create();
+    if (mpv == nullptr) return 1;
+    mpv_set_option_string(mpv, "vo", "null");
+    mpv_set_option_string(mpv, "ao", "null");
+    mpv_set_option_string(mpv, "idle", "yes");
+    mpv_set_option_string(mpv, "config", "no");
+    if (mpv_initialize(mpv) < 0) return 1;
+
+    Memory::install();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2((float)opts.width, (float)opts.height);
+    ImGui::StyleColorsDracula();
+    io.Fonts->AddFontDefault();
+
+    Raster raster(opts.width, opts.height);
+    raster.addFontAtlas(io.Fonts);
+
+    auto debug = new Debug(mpv, std::max(opts.logs, 5000));
+    int seq = 0;
+    addLogs(debug, opts.logs, seq);
+    if (!opts.file.empty()) {
+        const char *cmd[] = {"loadfile", opts.file.c_str(), nullptr};
+        mpv_command(mpv, cmd);
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::time_point a, clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    std::vector<double> uiTimes, rasterTimes;
+    size_t vertices = 0, indices = 0;
+    const int warmup = 10;
+    for (int frame = 0; frame < warmup + opts.frames; frame++) {
+        pumpEvents(mpv, debug);
+        addLogs(debug, opts.logRate, seq);
+
+        io.DeltaTime = 1.0f / 60;
+        Memory::newFrame();
+        auto t0 = clock::now();
+        ImGui::NewFrame();
+        debug->draw();
+        ImGui::Render();
+        auto t1 = clock::now();
+        raster.clear(0xff000000);
+        raster.render(ImGui::GetDrawData());
+        auto t2 = clock::now();
+
+        if (frame == 0) {
+            ImGui::SetWindowPos("Debug", ImVec2(0, 0));
+            ImGui::SetWindowSize("Debug", io.DisplaySize);
+            if (opts.open) openSections(mpv);
+        }
+        if (frame < warmup) continue;
+        uiTimes.push_back(ms(t0, t1));
+        rasterTimes.push_back(ms(t1, t2));
+        vertices += ImGui::GetDrawData()->TotalVtxCount;
+        indices += ImGui::GetDrawData()->TotalIdxCount;
+    }
+
+    printf("%d frames at %dx%d, %zu vertices and %zu indices per frame\n", opts.frames, opts.width, opts.height,
+           vertices / opts.frames, indices / opts.frames);
+    printTimes("ui", uiTimes);
+    printTimes("raster", rasterTimes);
+
+    int ret = 0;
+    auto &image = raster.target();
+    if (!opts.out.empty() && !image.save(opts.out)) {
+        fprintf(stderr, "failed to write %s\n", opts.out.c_str());
+        ret = 1;
+    }
+    if (!opts.compare.empty()) {
+        Image ref, diff;
+        if (!ref.load(opts.compare) || ref.width != image.width || ref.height != image.height) {
+            fprintf(stderr, "%s: missing or different size\n", opts.compare.c_str());
+            ret = 1;
+        } else {
+            double changed = compareImages(image, ref, diff);
+            printf("%.4f%% of pixels differ from %s\n", changed * 100, opts.compare.c_str());
+            if (changed > opts.tolerance) {
+                diff.save(opts.compare + ".diff.ppm");
+                ret = 1;
+            }
+        }
+    }
+
+    delete debug;
+    ImGui::DestroyContext();
+    mpv_terminate_destroy(mpv);
+    return ret;
+}
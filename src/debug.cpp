@@ -4,20 +4,89 @@
 #include <cstdarg>
 #include <cstdio>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <map>
+#include <unordered_map>
 #include <fmt/format.h>
 #include <imgui.h>
 #include <imgui_internal.h>
 #include "debug.h"
 
-static bool findCase(std::string haystack, std::string needle) {
-    auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
-                          [](char ch1, char ch2) { return std::toupper(ch1) == std::toupper(ch2); });
-    return it != haystack.end();
+static std::string expandPath(mpv_handle* mpv, const char* path) {
+    std::string ret = path;
+    mpv_node node{0};
+    const char* args[] = {"expand-path", path, NULL};
+    if (mpv_command_ret(mpv, args, &node) >= 0) {
+        ret = node.u.string;
+        mpv_free_node_contents(&node);
+    }
+    return ret;
+}
+
+// splits a command line into arguments, honoring "double" and 'single' quotes
+static std::vector<std::string> splitCommand(const char* line) {
+    std::vector<std::string> args;
+    const char* p = line;
+    for (;;) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '#') break;
+        std::string arg;
+        while (*p && *p != ' ' && *p != '\t') {
+            if (*p == '"' || *p == '\'') {
+                char quote = *p++;
+                while (*p && *p != quote) {
+                    if (quote == '"' && *p == '\\' && p[1]) p++;
+                    arg += *p++;
+                }
+                if (*p) p++;
+            } else {
+                arg += *p++;
+            }
+        }
+        args.push_back(arg);
+    }
+    return args;
+}
+
+static std::string toLower(std::string_view str) {
+    std::string ret(str);
+    for (auto& ch : ret) ch = std::tolower((unsigned char)ch);
+    return ret;
 }
 
-Debug::Debug(mpv_handle* mpv, int logLines) : mpv(mpv) {
+std::string_view StringPool::intern(std::string_view str) {
+    if (auto it = index.find(str); it != index.end()) return *it;
+
+    size_t size = str.size() + 1;
+    char* dst;
+    if (size > ChunkSize / 4) {
+        chunks.emplace_back((char*)Memory::alloc(size, MemTag::Strings));
+        dst = chunks.back().get();
+    } else {
+        if (head == nullptr || offset + size > ChunkSize) {
+            chunks.emplace_back((char*)Memory::alloc(ChunkSize, MemTag::Strings));
+            head = chunks.back().get();
+            offset = 0;
+        }
+        dst = head + offset;
+        offset += size;
+    }
+    memcpy(dst, str.data(), str.size());
+    dst[str.size()] = '\0';
+    used += size;
+
+    std::string_view ret(dst, str.size());
+    index.insert(ret);
+    return ret;
+}
+
+Debug::Debug(mpv_handle* mpv, int logLines, bool logCollapse) : mpv(mpv) {
     console = new Console(mpv, logLines);
+    console->Collapse = logCollapse;
     version = mpv_get_property_string(mpv, "mpv-version");
 
     mpv_node node{0};
@@ -45,18 +114,34 @@ Debug::~Debug() {
 
 void Debug::show() { m_open = true; }
 
+void Debug::hide() { m_open = false; }
+
+bool Debug::isOpen() { return m_open; }
+
+bool Debug::busy() { return console->Exporter.running; }
+
+bool Debug::benching() {
+    std::lock_guard<std::mutex> lock(console->BenchLock);
+    return console->Runner.running;
+}
+
 void Debug::draw() {
     if (!m_open) return;
     ImGui::SetNextWindowSizeConstraints(ImGui::EmVec2(25, 30), ImVec2(FLT_MAX, FLT_MAX));
     ImGui::SetNextWindowSize(ImGui::EmVec2(40, 60), ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowPos(ImGui::GetMainViewport()->WorkPos, ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Debug", &m_open, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoScrollbar)) {
+        auto& options = *m_options.acquire();
+        auto& properties = *m_properties.acquire();
+        auto& commands = *m_commands.acquire();
+        auto& bindings = *m_bindings.acquire();
         drawHeader();
         drawProperties("Options", options);
         drawProperties("Properties", properties);
-        drawBindings();
-        drawCommands();
-        drawConsole();
+        drawBindings(bindings);
+        drawCommands(commands);
+        drawMemory();
+        drawConsole(commands, options, properties);
     }
     ImGui::End();
     if (m_demo) ImGui::ShowDemoWindow(&m_demo);
@@ -73,23 +158,75 @@ void Debug::drawHeader() {
     ImGui::Spacing();
 }
 
-void Debug::drawConsole() {
+void Debug::drawConsole(const Table<Command>& commands, const Table<Name>& options, const Table<Name>& properties) {
     ImGui::SetNextItemOpen(true, ImGuiCond_Once);
     if (!ImGui::CollapsingHeader("Console", ImGuiTreeNodeFlags_DefaultOpen)) return;
+    console->initCompletion(commands, options, properties);
     console->draw();
 }
 
-void Debug::drawBindings() {
-    if (!ImGui::CollapsingHeader(fmt::format("Bindings [{}]", bindings.size()).c_str())) return;
-    static char buf[256] = "";
+void Debug::sortBindings(const Table<Binding>& bindings) {
+    auto& view = bindingsView;
+    auto& rows = bindings.rows;
+    auto filter = toLower(view.filter);
+
+    view.rows.clear();
+    for (int i = 0; i < (int)rows.size(); i++) {
+        auto& binding = rows[i];
+        if (!filter.empty() && binding.keyLower.find(filter) == std::string_view::npos &&
+            binding.cmdLower.find(filter) == std::string_view::npos)
+            continue;
+        view.rows.push_back(i);
+    }
+
+    auto compare = [&](const Binding& a, const Binding& b, int column) -> int {
+        switch (column) {
+            case 0:
+                return a.section.compare(b.section);
+            case 1:
+                return a.priority < b.priority ? -1 : a.priority > b.priority;
+            case 2:
+                return (int)a.weak - (int)b.weak;
+            case 3:
+                return a.keyLower.compare(b.keyLower);
+            case 4:
+                return a.cmdLower.compare(b.cmdLower);
+            case 5:
+                return a.comment.compare(b.comment);
+            default:
+                return 0;
+        }
+    };
+    if (!view.specs.empty()) {
+        std::stable_sort(view.rows.begin(), view.rows.end(), [&](int a, int b) {
+            for (auto& spec : view.specs) {
+                int delta = compare(rows[a], rows[b], spec.ColumnIndex);
+                if (delta == 0) continue;
+                return spec.SortDirection == ImGuiSortDirection_Ascending ? delta < 0 : delta > 0;
+            }
+            return false;
+        });
+    }
+
+    view.generation = bindings.generation;
+    view.dirty = false;
+}
+
+void Debug::drawBindings(const Table<Binding>& bindings) {
+    bool open = ImGui::CollapsingHeader(fmt::format("Bindings [{}]", bindings.rows.size()).c_str());
+    drawTableStats(bindings.stats);
+    if (!open) return;
+    auto& view = bindingsView;
     ImGui::TextUnformatted("Filter:");
     ImGui::SameLine();
     ImGui::PushItemWidth(-1);
-    ImGui::InputText("##Filter.bindings", buf, IM_ARRAYSIZE(buf));
+    if (ImGui::InputText("##Filter.bindings", view.filter, IM_ARRAYSIZE(view.filter))) view.dirty = true;
     ImGui::PopItemWidth();
 
     static ImGuiTableFlags flags = ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter |
-                                   ImGuiTableFlags_BordersV | ImGuiTableFlags_NoBordersInBody | ImGuiTableFlags_ScrollY;
+                                   ImGuiTableFlags_BordersV | ImGuiTableFlags_NoBordersInBody |
+                                   ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable |
+                                   ImGuiTableFlags_SortMulti | ImGuiTableFlags_SortTristate;
     if (ImGui::BeginTable("input-bindings", 6, flags)) {
         ImGui::TableSetupScrollFreeze(0, 1);
         ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthFixed);
@@ -99,21 +236,35 @@ void Debug::drawBindings() {
         ImGui::TableSetupColumn("Command", ImGuiTableColumnFlags_WidthStretch);
         ImGui::TableSetupColumn("Comment", ImGuiTableColumnFlags_WidthStretch);
         ImGui::TableHeadersRow();
-        for (auto& binding : bindings) {
-            if (buf[0] != '\0' && !findCase(binding.key, buf) && !findCase(binding.cmd, buf)) continue;
-            ImGui::TableNextRow();
-            ImGui::TableNextColumn();
-            ImGui::Selectable(binding.section.c_str(), false, ImGuiSelectableFlags_SpanAllColumns);
-            ImGui::TableNextColumn();
-            ImGui::Text("%d", binding.priority);
-            ImGui::TableNextColumn();
-            ImGui::Text("%s", binding.weak ? "yes" : "no");
-            ImGui::TableNextColumn();
-            ImGui::Text("%s", binding.key.c_str());
-            ImGui::TableNextColumn();
-            ImGui::Text("%s", binding.cmd.c_str());
-            ImGui::TableNextColumn();
-            ImGui::Text("%s", binding.comment.c_str());
+
+        if (ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsDirty) {
+            view.specs.assign(specs->Specs, specs->Specs + specs->SpecsCount);
+            specs->SpecsDirty = false;
+            view.dirty = true;
+        }
+        if (view.dirty || view.generation != bindings.generation) sortBindings(bindings);
+
+        ImGuiListClipper clipper;
+        clipper.Begin((int)view.rows.size());
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                auto& binding = bindings.rows[view.rows[i]];
+                ImGui::PushID(i);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Selectable(binding.section.data(), false, ImGuiSelectableFlags_SpanAllColumns);
+                ImGui::TableNextColumn();
+                ImGui::Text("%lld", (long long)binding.priority);
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", binding.weak ? "yes" : "no");
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", binding.key.data());
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", binding.cmd.data());
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", binding.comment.data());
+                ImGui::PopID();
+            }
         }
         ImGui::EndTable();
     }
@@ -155,50 +306,205 @@ static void formatCommands(mpv_node& node, std::vector<std::pair<std::string, st
     }
 }
 
+// publish rebuilt rows, compacting the pool once most of it is garbage
+// left behind by removed entries
+template <typename T>
+void Debug::Table<T>::commit(std::vector<T>&& built, size_t changed, std::chrono::steady_clock::time_point start) {
+    size_t live = 0;
+    for (auto& row : built) row.visit([&](std::string_view& str) { live += str.size() + 1; });
+    if (pool->bytes() > 256 * 1024 && pool->bytes() > live * 4) {
+        auto fresh = std::make_shared<StringPool>();
+        for (auto& row : built) row.visit([&](std::string_view& str) { str = fresh->intern(str); });
+        pool = std::move(fresh);
+    }
+
+    stats.updates++;
+    stats.rows = built.size();
+    stats.changed = changed;
+    stats.reused = built.size() - changed;
+    stats.poolBytes = pool->bytes();
+    stats.micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    rows = std::move(built);
+    generation++;
+}
+
+void Debug::updateNames(Snapshot<Table<Name>>& snapshot, mpv_node& node) {
+    auto start = std::chrono::steady_clock::now();
+    auto base = snapshot.latest();
+    auto table = base->next();
+    auto& pool = *table->pool;
+    auto& prev = base->rows;
+    std::unordered_map<const char*, const Name*> index;
+    std::vector<Name> rows;
+    size_t changed = 0;
+
+    rows.reserve(node.u.list->num);
+    for (int i = 0; i < node.u.list->num; i++) {
+        auto name = pool.intern(node.u.list->values[i].u.string);
+        if ((size_t)i < prev.size() && prev[i].name.data() == name.data()) {
+            rows.push_back(prev[i]);
+            continue;
+        }
+        if (index.empty())
+            for (auto& row : prev) index.emplace(row.name.data(), &row);
+        if (auto it = index.find(name.data()); it != index.end()) {
+            rows.push_back(*it->second);
+            continue;
+        }
+        rows.push_back({name, pool.intern(toLower(name))});
+        changed++;
+    }
+    table->commit(std::move(rows), changed, start);
+    snapshot.publish(std::move(table));
+}
+
+void Debug::updateCommands(Snapshot<Table<Command>>& snapshot, mpv_node& node) {
+    auto start = std::chrono::steady_clock::now();
+    auto base = snapshot.latest();
+    auto table = base->next();
+    auto& pool = *table->pool;
+    auto& prev = base->rows;
+    std::vector<std::pair<std::string, std::string>> commands;
+    std::vector<Command> rows;
+    size_t changed = 0;
+
+    formatCommands(node, commands);
+    rows.reserve(commands.size());
+    for (size_t i = 0; i < commands.size(); i++) {
+        auto name = pool.intern(commands[i].first);
+        auto args = pool.intern(commands[i].second);
+        if ((size_t)i < prev.size() && prev[i].name.data() == name.data() && prev[i].args.data() == args.data()) {
+            rows.push_back(prev[i]);
+            continue;
+        }
+        rows.push_back({name, args, pool.intern(toLower(name))});
+        changed++;
+    }
+    table->commit(std::move(rows), changed, start);
+    snapshot.publish(std::move(table));
+}
+
+void Debug::updateBindings(Snapshot<Table<Binding>>& snapshot, mpv_node& node) {
+    auto start = std::chrono::steady_clock::now();
+    auto base = snapshot.latest();
+    auto table = base->next();
+    auto& pool = *table->pool;
+    auto& prev = base->rows;
+    auto hash = [](const Binding& b) {
+        auto h = std::hash<const void*>();
+        return h(b.section.data()) ^ (h(b.key.data()) << 1) ^ (h(b.cmd.data()) << 2);
+    };
+    auto same = [](const Binding& a, const Binding& b) {
+        return a.section.data() == b.section.data() && a.key.data() == b.key.data() &&
+               a.cmd.data() == b.cmd.data() && a.comment.data() == b.comment.data() && a.priority == b.priority &&
+               a.weak == b.weak;
+    };
+    std::unordered_multimap<size_t, const Binding*> index;
+    std::vector<Binding> rows;
+    size_t changed = 0;
+
+    rows.reserve(node.u.list->num);
+    for (int i = 0; i < node.u.list->num; i++) {
+        auto item = node.u.list->values[i];
+        Binding binding;
+        for (int j = 0; j < item.u.list->num; j++) {
+            auto key = item.u.list->keys[j];
+            auto value = item.u.list->values[j];
+            if (strcmp(key, "section") == 0) {
+                binding.section = pool.intern(value.u.string);
+            } else if (strcmp(key, "key") == 0) {
+                binding.key = pool.intern(value.u.string);
+            } else if (strcmp(key, "cmd") == 0) {
+                binding.cmd = pool.intern(value.u.string);
+            } else if (strcmp(key, "comment") == 0) {
+                binding.comment = pool.intern(value.u.string);
+            } else if (strcmp(key, "priority") == 0) {
+                binding.priority = value.u.int64;
+            } else if (strcmp(key, "is_weak") == 0) {
+                binding.weak = value.u.flag;
+            }
+        }
+        if ((size_t)i < prev.size() && same(prev[i], binding)) {
+            rows.push_back(prev[i]);
+            continue;
+        }
+        if (index.empty())
+            for (auto& row : prev) index.emplace(hash(row), &row);
+        auto [begin, end] = index.equal_range(hash(binding));
+        auto it = std::find_if(begin, end, [&](auto& kv) { return same(*kv.second, binding); });
+        if (it != end) {
+            rows.push_back(*it->second);
+            continue;
+        }
+        binding.keyLower = pool.intern(toLower(binding.key));
+        binding.cmdLower = pool.intern(toLower(binding.cmd));
+        rows.push_back(binding);
+        changed++;
+    }
+    table->commit(std::move(rows), changed, start);
+    snapshot.publish(std::move(table));
+}
+
 void Debug::update(mpv_event_property* prop) {
     if (prop->format != MPV_FORMAT_NODE) return;
     mpv_node* node = (mpv_node*)prop->data;
     if (node->format != MPV_FORMAT_NODE_ARRAY) return;
 
     if (strcmp(prop->name, "options") == 0) {
-        options.clear();
-        for (int i = 0; i < node->u.list->num; i++) options.push_back(node->u.list->values[i].u.string);
+        updateNames(m_options, *node);
     } else if (strcmp(prop->name, "property-list") == 0) {
-        properties.clear();
-        for (int i = 0; i < node->u.list->num; i++) properties.push_back(node->u.list->values[i].u.string);
+        updateNames(m_properties, *node);
     } else if (strcmp(prop->name, "command-list") == 0) {
-        commands.clear();
-        formatCommands(*node, commands);
-        console->initCommands(commands);
+        updateCommands(m_commands, *node);
     } else if (strcmp(prop->name, "input-bindings") == 0) {
-        bindings.clear();
-        for (int i = 0; i < node->u.list->num; i++) {
-            auto item = node->u.list->values[i];
-            Binding binding;
-            for (int j = 0; j < item.u.list->num; j++) {
-                auto key = item.u.list->keys[j];
-                auto value = item.u.list->values[j];
-                if (strcmp(key, "section") == 0) {
-                    binding.section = value.u.string;
-                } else if (strcmp(key, "key") == 0) {
-                    binding.key = value.u.string;
-                } else if (strcmp(key, "cmd") == 0) {
-                    binding.cmd = value.u.string;
-                } else if (strcmp(key, "comment") == 0) {
-                    binding.comment = value.u.string;
-                } else if (strcmp(key, "priority") == 0) {
-                    binding.priority = value.u.int64;
-                } else if (strcmp(key, "is_weak") == 0) {
-                    binding.weak = value.u.flag;
-                }
-            }
-            bindings.emplace_back(binding);
+        updateBindings(m_bindings, *node);
+    }
+}
+
+void Debug::drawTableStats(const TableStats& stats) {
+    if (!ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal)) return;
+    ImGui::SetTooltip("Rows: %zu (%zu reused, %zu rebuilt)\nUpdate #%zu took %lld us\nString pool: %.1f KB", stats.rows,
+                      stats.reused, stats.changed, stats.updates, (long long)stats.micros, stats.poolBytes / 1024.0);
+}
+
+void Debug::drawMemory() {
+    if (!ImGui::CollapsingHeader("Memory")) return;
+    ImGui::Text("Pools reserved: %.1f KB", Memory::reserved() / 1024.0);
+
+    static ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV;
+    if (ImGui::BeginTable("memory", 5, flags)) {
+        ImGui::TableSetupColumn("Subsystem", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Live", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Peak", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Allocs", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Per frame", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < (int)MemTag::Count; i++) {
+            auto stats = Memory::stats((MemTag)i);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(Memory::name((MemTag)i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f KB", stats.live / 1024.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f KB", stats.peak / 1024.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", stats.allocs - stats.frees);
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+                ImGui::SetTooltip("%zu allocated, %zu freed", stats.allocs, stats.frees);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", stats.frame);
         }
+        ImGui::EndTable();
     }
 }
 
-void Debug::drawCommands() {
-    if (!ImGui::CollapsingHeader(fmt::format("Commands [{}]", commands.size()).c_str())) return;
+void Debug::drawCommands(const Table<Command>& commands) {
+    bool open = ImGui::CollapsingHeader(fmt::format("Commands [{}]", commands.rows.size()).c_str());
+    drawTableStats(commands.stats);
+    if (!open) return;
     static char buf[256] = "";
     ImGui::TextUnformatted("Filter:");
     ImGui::SameLine();
@@ -206,15 +512,16 @@ void Debug::drawCommands() {
     ImGui::InputText("##Filter.commands", buf, IM_ARRAYSIZE(buf));
     ImGui::PopItemWidth();
     if (ImGui::BeginListBox("command-list", ImVec2(-FLT_MIN, -FLT_MIN))) {
-        for (auto& [name, args] : commands) {
-            if (buf[0] != '\0' && !findCase(name, buf)) continue;
-            ImGui::PushID(name.c_str());
+        auto filter = toLower(buf);
+        for (auto& [name, args, lower] : commands.rows) {
+            if (!filter.empty() && lower.find(filter) == std::string_view::npos) continue;
+            ImGui::PushID(name.data());
             ImGui::Selectable("", false);
             ImGui::SameLine();
-            ImGui::TextColored(ImGui::GetStyle().Colors[ImGuiCol_CheckMark], "%s", name.c_str());
+            ImGui::TextColored(ImGui::GetStyle().Colors[ImGuiCol_CheckMark], "%s", name.data());
             if (!args.empty()) {
                 ImGui::SameLine();
-                ImGui::Text("%s", args.c_str());
+                ImGui::Text("%s", args.data());
             }
             ImGui::PopID();
         }
@@ -222,13 +529,16 @@ void Debug::drawCommands() {
     }
 }
 
-void Debug::drawProperties(const char* title, std::vector<std::string>& props) {
-    if (!ImGui::CollapsingHeader(fmt::format("{} [{}]", title, props.size()).c_str())) return;
+void Debug::drawProperties(const char* title, const Table<Name>& props) {
+    bool open = ImGui::CollapsingHeader(fmt::format("{} [{}]", title, props.rows.size()).c_str());
+    drawTableStats(props.stats);
+    if (!open) return;
 
     int mask = 1 << MPV_FORMAT_NONE | 1 << MPV_FORMAT_STRING | 1 << MPV_FORMAT_OSD_STRING | 1 << MPV_FORMAT_FLAG |
                1 << MPV_FORMAT_INT64 | 1 << MPV_FORMAT_DOUBLE | 1 << MPV_FORMAT_NODE | 1 << MPV_FORMAT_NODE_ARRAY |
                1 << MPV_FORMAT_NODE_MAP | 1 << MPV_FORMAT_BYTE_ARRAY;
     static int format = mask;
+    static bool lazy = false;
     static char buf[256] = "";
     ImGui::AlignTextToFramePadding();
     ImGui::TextUnformatted("Format:");
@@ -236,6 +546,10 @@ void Debug::drawProperties(const char* title, std::vector<std::string>& props) {
     ImGui::CheckboxFlags("ALL", &format, mask);
     ImGui::SameLine();
     ImGui::CheckboxFlags("NONE", &format, 1 << MPV_FORMAT_NONE);
+    ImGui::SameLine();
+    ImGui::Checkbox("Lazy", &lazy);
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+        ImGui::SetTooltip("Fetch list entries (e.g. playlist/123) only when they are expanded");
     ImGui::Indent();
     ImGui::CheckboxFlags("STRING", &format, 1 << MPV_FORMAT_STRING);
     ImGui::SameLine();
@@ -258,103 +572,265 @@ void Debug::drawProperties(const char* title, std::vector<std::string>& props) {
     ImGui::InputText("##Filter.properties", buf, IM_ARRAYSIZE(buf));
     ImGui::PopItemWidth();
     auto posY = ImGui::GetCursorScreenPos().y;
+    auto& cache = propCache[title];
     if (format > 0 && ImGui::BeginListBox(title, ImVec2(-FLT_MIN, -FLT_MIN))) {
-        for (auto& name : props) {
-            if (buf[0] != '\0' && name.find(buf) == std::string::npos) continue;
+        auto filter = toLower(buf);
+        for (auto& [name, lower] : props.rows) {
+            if (!filter.empty() && lower.find(filter) == std::string_view::npos) continue;
             if (ImGui::GetCursorScreenPos().y > posY + ImGui::GetStyle().FramePadding.y && !ImGui::IsItemVisible()) {
-                ImGui::BulletText("%s", name.c_str());
+                ImGui::BulletText("%s", name.data());
+                continue;
+            }
+            auto [it, inserted] = cache.try_emplace(std::string(name));
+            auto& node = it->second;
+            if (inserted) node.name = name;
+            if (lazy && syncLazyList(node)) {
+                if (format & 1 << node.format) drawPropNode(node);
                 continue;
             }
             mpv_node prop{0};
-            mpv_get_property(mpv, name.c_str(), MPV_FORMAT_NODE, &prop);
-            if (format & 1 << prop.format) drawPropNode(name.c_str(), prop);
+            mpv_get_property(mpv, name.data(), MPV_FORMAT_NODE, &prop);
+            syncPropNode(node, prop);
             mpv_free_node_contents(&prop);
+            if (format & 1 << node.format) drawPropNode(node);
         }
         ImGui::EndListBox();
     }
 }
 
-void Debug::drawPropNode(const char* name, mpv_node& node, int depth) {
-    constexpr static auto drawSimple = [&](const char* title, mpv_node prop) {
-        std::string value;
-        auto style = ImGuiStyle();
-        ImVec4 color = style.Colors[ImGuiCol_CheckMark];
-        switch (prop.format) {
-            case MPV_FORMAT_OSD_STRING:
-            case MPV_FORMAT_STRING:
-                value = prop.u.string;
-                break;
-            case MPV_FORMAT_FLAG:
-                value = prop.u.flag ? "yes" : "no";
-                break;
-            case MPV_FORMAT_INT64:
-                value = fmt::format("{}", prop.u.int64);
-                break;
-            case MPV_FORMAT_DOUBLE:
-                value = fmt::format("{}", prop.u.double_);
-                break;
-            case MPV_FORMAT_BYTE_ARRAY:
-                value = fmt::format("byte array [{}]", prop.u.ba->size);
-                break;
-            case MPV_FORMAT_NONE:
-            default:
-                value = "<Empty>";
-                color = style.Colors[ImGuiCol_TextDisabled];
-                break;
-        }
-        ImGui::PushID(&prop);
-        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, ImGui::GetStyle().ItemSpacing.y));
-        ImGui::Selectable("", false);
-        if (ImGui::BeginPopupContextItem(fmt::format("##menu_{}", title).c_str())) {
-            if (ImGui::MenuItem("Copy")) ImGui::SetClipboardText(fmt::format("{}={}", title, value).c_str());
-            if (ImGui::MenuItem("Copy Name")) ImGui::SetClipboardText(title);
-            if (ImGui::MenuItem("Copy Value")) ImGui::SetClipboardText(value.c_str());
-            ImGui::EndPopup();
-        }
-        ImGui::SameLine();
-        ImGui::BulletText("%s", title);
-        ImGui::SameLine(ImGui::GetContentRegionAvail().x * 0.5f);
-        ImGui::TextColored(color, "%s", value.c_str());
-        if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal)) ImGui::SetTooltip("%s", value.c_str());
-        ImGui::PopStyleVar();
-        ImGui::PopID();
-    };
+void Debug::resizePropList(PropNode& cache, int count, bool isArray) {
+    int size = (int)cache.children.size();
+    cache.children.resize(count);
+    if (isArray)
+        for (int i = size; i < count; i++) cache.children[i].name = fmt::format("#{}", i);
+    cache.chunks.clear();
+    if (count > PropNode::ChunkSize) {
+        for (int i = 0; i < count; i += PropNode::ChunkSize)
+            cache.chunks.emplace_back(fmt::format("items {}-{}", i, std::min(i + PropNode::ChunkSize, count) - 1));
+    }
+}
+
+void Debug::syncPropNode(PropNode& cache, mpv_node& node, bool relabel) {
+    bool changed = relabel || cache.generation == 0 || cache.format != node.format || cache.lazy;
+    cache.lazy = false;
+    if (cache.format != node.format) cache.children.clear();
+    cache.format = node.format;
 
     switch (node.format) {
         case MPV_FORMAT_NODE_ARRAY:
-            if (ImGui::TreeNode(fmt::format("{} [{}]", name, node.u.list->num).c_str())) {
-                for (int i = 0; i < node.u.list->num; i++)
-                    drawPropNode(fmt::format("#{}", i).c_str(), node.u.list->values[i], depth + 1);
-                ImGui::TreePop();
+        case MPV_FORMAT_NODE_MAP: {
+            auto list = node.u.list;
+            bool isArray = node.format == MPV_FORMAT_NODE_ARRAY;
+            int size = (int)cache.children.size();
+            if (size != list->num) {
+                changed = true;
+                resizePropList(cache, list->num, isArray);
+            }
+            for (int i = 0; i < list->num; i++) {
+                auto& child = cache.children[i];
+                bool rename = !isArray && child.name != list->keys[i];
+                if (rename) child.name = list->keys[i];
+                syncPropNode(child, list->values[i], rename || i >= size);
+            }
+            if (changed)
+                cache.label = isArray ? fmt::format("{} [{}]", cache.name, list->num)
+                                      : fmt::format("{} ({})", cache.name, list->num);
+            break;
+        }
+        case MPV_FORMAT_OSD_STRING:
+        case MPV_FORMAT_STRING:
+            if (changed || cache.value != node.u.string) {
+                cache.value = node.u.string;
+                changed = true;
+            }
+            break;
+        case MPV_FORMAT_FLAG:
+            if (changed || cache.raw.flag != node.u.flag) {
+                cache.raw.flag = node.u.flag;
+                cache.value = node.u.flag ? "yes" : "no";
+                changed = true;
             }
             break;
+        case MPV_FORMAT_INT64:
+            if (changed || cache.raw.int64 != node.u.int64) {
+                cache.raw.int64 = node.u.int64;
+                cache.value = fmt::format("{}", node.u.int64);
+                changed = true;
+            }
+            break;
+        case MPV_FORMAT_DOUBLE:
+            if (changed || cache.raw.double_ != node.u.double_) {
+                cache.raw.double_ = node.u.double_;
+                cache.value = fmt::format("{}", node.u.double_);
+                changed = true;
+            }
+            break;
+        case MPV_FORMAT_BYTE_ARRAY:
+            if (changed || cache.raw.size != node.u.ba->size) {
+                cache.raw.size = node.u.ba->size;
+                cache.value = fmt::format("byte array [{}]", node.u.ba->size);
+                changed = true;
+            }
+            break;
+        case MPV_FORMAT_NONE:
+        default:
+            if (changed) cache.value = "<Empty>";
+            break;
+    }
+    if (changed) cache.generation++;
+}
+
+// list properties are shown from their <name>/count, entries are fetched
+// through <name>/<index> only when expanded
+bool Debug::syncLazyList(PropNode& node) {
+    if (node.probed && !node.countable) return false;
+    int64_t count = 0;
+    bool ok = mpv_get_property(mpv, fmt::format("{}/count", node.name).c_str(), MPV_FORMAT_INT64, &count) >= 0;
+    if (!node.probed) {
+        node.probed = true;
+        node.countable = ok;
+    }
+    if (!ok || count < 0) return false;
+
+    if (!node.lazy || node.format != MPV_FORMAT_NODE_ARRAY) node.children.clear();
+    if (!node.lazy || (int)node.children.size() != count) {
+        node.format = MPV_FORMAT_NODE_ARRAY;
+        node.lazy = true;
+        resizePropList(node, (int)count, true);
+        node.label = fmt::format("{} [{}]", node.name, count);
+        node.generation++;
+    }
+    return true;
+}
+
+void Debug::drawLazyChild(PropNode& list, int index) {
+    auto& child = list.children[index];
+    child.open = ImGui::TreeNodeEx(child.name.c_str(), ImGuiTreeNodeFlags_None, "%s", child.name.c_str());
+    if (!child.open) return;
+
+    mpv_node prop{0};
+    mpv_get_property(mpv, fmt::format("{}/{}", list.name, index).c_str(), MPV_FORMAT_NODE, &prop);
+    syncPropNode(child, prop);
+    mpv_free_node_contents(&prop);
+    child.open = true;
+    if (child.format == MPV_FORMAT_NODE_ARRAY || child.format == MPV_FORMAT_NODE_MAP)
+        drawPropChildren(child, 0, (int)child.children.size(), 1);
+    else
+        drawPropValue(child);
+    ImGui::TreePop();
+}
+
+void Debug::drawPropValue(PropNode& node) {
+    auto& style = ImGui::GetStyle();
+    ImVec4 color = style.Colors[node.format == MPV_FORMAT_NONE ? ImGuiCol_TextDisabled : ImGuiCol_CheckMark];
+    ImGui::PushID(&node);
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, style.ItemSpacing.y));
+    ImGui::Selectable("", false);
+    if (ImGui::BeginPopupContextItem("##menu")) {
+        if (ImGui::MenuItem("Copy")) ImGui::SetClipboardText(fmt::format("{}={}", node.name, node.value).c_str());
+        if (ImGui::MenuItem("Copy Name")) ImGui::SetClipboardText(node.name.c_str());
+        if (ImGui::MenuItem("Copy Value")) ImGui::SetClipboardText(node.value.c_str());
+        ImGui::EndPopup();
+    }
+    ImGui::SameLine();
+    ImGui::BulletText("%s", node.name.c_str());
+    ImGui::SameLine(ImGui::GetContentRegionAvail().x * 0.5f);
+    ImGui::TextColored(color, "%s", node.value.c_str());
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal)) ImGui::SetTooltip("%s", node.value.c_str());
+    ImGui::PopStyleVar();
+    ImGui::PopID();
+}
+
+// collapsed children are single rows and go through a clipper, expanded
+// ones split the range and are drawn in full
+void Debug::drawPropChildren(PropNode& node, int begin, int end, int depth) {
+    bool isArray = node.format == MPV_FORMAT_NODE_ARRAY;
+    int childDepth = isArray && node.children.size() <= PropNode::AutoOpenLimit ? depth + 1 : 0;
+    auto draw = [&](int k) {
+        if (node.lazy)
+            drawLazyChild(node, k);
+        else
+            drawPropNode(node.children[k], childDepth);
+    };
+    // short arrays auto-open their maps on first draw, which would throw off
+    // the clipper's height measurement, so they are drawn in full
+    if (childDepth > 0 && !node.lazy) {
+        for (int k = begin; k < end; k++) draw(k);
+        return;
+    }
+    int i = begin;
+    while (i < end) {
+        int j = i;
+        while (j < end && !node.children[j].open) j++;
+        ImGuiListClipper clipper;
+        clipper.Begin(j - i);
+        while (clipper.Step())
+            for (int k = clipper.DisplayStart; k < clipper.DisplayEnd; k++) draw(i + k);
+        if (j < end) draw(j++);
+        i = j;
+    }
+}
+
+void Debug::drawPropNode(PropNode& node, int depth) {
+    switch (node.format) {
+        case MPV_FORMAT_NODE_ARRAY:
         case MPV_FORMAT_NODE_MAP:
-            if (depth > 0) ImGui::SetNextItemOpen(true, ImGuiCond_Once);
-            if (ImGui::TreeNode(fmt::format("{} ({})", name, node.u.list->num).c_str())) {
-                for (int i = 0; i < node.u.list->num; i++) drawPropNode(node.u.list->keys[i], node.u.list->values[i]);
-                ImGui::TreePop();
+            if (node.format == MPV_FORMAT_NODE_MAP && depth > 0) ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+            node.open = ImGui::TreeNodeEx(node.name.c_str(), ImGuiTreeNodeFlags_None, "%s", node.label.c_str());
+            if (!node.open) break;
+            if (node.chunks.empty()) {
+                drawPropChildren(node, 0, (int)node.children.size(), depth);
+            } else {
+                for (int c = 0; c < (int)node.chunks.size(); c++) {
+                    if (!ImGui::TreeNodeEx((void*)(intptr_t)c, ImGuiTreeNodeFlags_None, "%s", node.chunks[c].c_str()))
+                        continue;
+                    int begin = c * PropNode::ChunkSize;
+                    drawPropChildren(node, begin, std::min(begin + PropNode::ChunkSize, (int)node.children.size()),
+                                     depth);
+                    ImGui::TreePop();
+                }
             }
+            ImGui::TreePop();
             break;
         default:
-            drawSimple(name, node);
+            node.open = false;
+            drawPropValue(node);
             break;
     }
 }
 
+void Debug::handleEvent(mpv_event* event) {
+    if (event->event_id == MPV_EVENT_PROPERTY_CHANGE)
+        console->WatchEvent(event);
+    else
+        console->BenchEvent(event);
+}
+
 void Debug::AddLog(const char* prefix, const char* level, const char* text) {
     console->AddLog(level, "[%s] %s", prefix, text);
 }
 
 Debug::Console::Console(mpv_handle* mpv, int logLines) : mpv(mpv) {
+    StartTime = mpv_get_time_us(mpv);
+    auto wall = std::chrono::system_clock::now().time_since_epoch();
+    WallOffset = std::chrono::duration_cast<std::chrono::microseconds>(wall).count() - StartTime;
     ClearLog();
     memset(InputBuf, 0, sizeof(InputBuf));
     init("status", logLines);
 }
 
 Debug::Console::~Console() {
+    Exporter.cancel = true;
+    if (Exporter.thread.joinable()) Exporter.thread.join();
+    for (auto& w : Watches) mpv_unobserve_property(mpv, w.id);
+    {
+        std::lock_guard<std::mutex> lock(Dumps.lock);
+        Dumps.quit = true;
+    }
+    Dumps.cv.notify_one();
+    if (Dumps.thread.joinable()) Dumps.thread.join();
     ClearLog();
-    for (int i = 0; i < History.Size; i++) free(History[i]);
-    for (int i = 0; i < Commands.Size; i++) free(Commands[i]);
+    for (int i = 0; i < History.Size; i++) IM_FREE(History[i]);
 }
 
 void Debug::Console::init(const char* level, int limit) {
@@ -363,15 +839,247 @@ void Debug::Console::init(const char* level, int limit) {
     mpv_request_log_messages(mpv, level);
 }
 
-void Debug::Console::initCommands(std::vector<std::pair<std::string, std::string>>& commands) {
-    if (CommandInited) return;
-    for (auto& cmd : builtinCommands) Commands.push_back(ImStrdup(cmd.c_str()));
-    for (auto& [name, args] : commands) Commands.push_back(ImStrdup(name.c_str()));
-    CommandInited = true;
+void Debug::Console::WordIndex::build(std::vector<std::string>&& texts) {
+    words.clear();
+    words.reserve(texts.size());
+    for (auto& text : texts) words.push_back({toLower(text), std::move(text)});
+    std::sort(words.begin(), words.end(), [](auto& a, auto& b) { return a.lower < b.lower; });
+    words.erase(std::unique(words.begin(), words.end(), [](auto& a, auto& b) { return a.lower == b.lower; }),
+                words.end());
+}
+
+void Debug::Console::initCompletion(const Table<Command>& commands, const Table<Name>& options,
+                                    const Table<Name>& properties) {
+    auto& c = Completer;
+    bool changed = false;
+    if (c.commands.generation != commands.generation) {
+        std::vector<std::string> texts(builtinCommands.begin(), builtinCommands.end());
+        for (auto& cmd : commands.rows) texts.emplace_back(cmd.name);
+        c.commands.build(std::move(texts));
+        c.commands.generation = commands.generation;
+        changed = true;
+    }
+    uint64_t generation = options.generation << 32 | (properties.generation & 0xffffffff);
+    if (c.properties.generation != generation) {
+        std::vector<std::string> texts;
+        texts.reserve(options.rows.size() + properties.rows.size());
+        for (auto& opt : options.rows) texts.emplace_back(opt.name);
+        for (auto& prop : properties.rows) texts.emplace_back(prop.name);
+        c.properties.build(std::move(texts));
+        c.properties.generation = generation;
+        changed = true;
+    }
+    if (changed) {
+        // matches point into the rebuilt word lists
+        c.matches.clear();
+        c.index = nullptr;
+        c.visible = false;
+    }
+}
+
+// greedy subsequence match: -1 if no match, prefix matches rank above fuzzy ones
+static int fuzzyScore(std::string_view query, std::string_view word) {
+    if (word.starts_with(query)) return 1000 - (int)word.size();
+    int score = 0;
+    size_t pos = 0;
+    size_t last = std::string_view::npos;
+    for (char ch : query) {
+        size_t found = word.find(ch, pos);
+        if (found == std::string_view::npos) return -1;
+        if (last != std::string_view::npos && found == last + 1) score += 5;
+        if (found == 0 || strchr("-/_", word[found - 1])) score += 8;
+        score -= (int)(found - pos);
+        last = found;
+        pos = found + 1;
+    }
+    return std::clamp(score, 0, 999);
+}
+
+void Debug::Console::UpdateCandidates(const char* buf, int cursor, bool force) {
+    static const std::vector<std::string> prefixes = {
+        "no-osd", "osd-auto", "osd-bar", "osd-msg", "osd-msg-bar", "raw", "expand-properties",
+        "repeatable", "nonrepeatable", "async", "sync",
+    };
+    static const std::vector<std::string> propertyCommands = {
+        "set", "add", "multiply", "cycle", "cycle-values", "change-list",
+    };
+    auto& c = Completer;
+
+    int start = cursor;
+    while (start > 0 && !strchr(" \t,;", buf[start - 1])) start--;
+
+    std::vector<std::string> args;
+    for (const char* p = buf; p < buf + start;) {
+        while (p < buf + start && (*p == ' ' || *p == '\t')) p++;
+        const char* q = p;
+        while (q < buf + start && *q != ' ' && *q != '\t') q++;
+        if (q > p) args.emplace_back(p, q);
+        p = q;
+    }
+    size_t skip = 0;
+    while (skip < args.size() && std::find(prefixes.begin(), prefixes.end(), args[skip]) != prefixes.end()) skip++;
+    args.erase(args.begin(), args.begin() + skip);
+
+    auto source = Completion::None;
+    std::string context;
+    if (args.empty()) {
+        source = Completion::Commands;
+    } else {
+        auto cmd = toLower(args[0]);
+        bool isPropertyCommand = std::find(propertyCommands.begin(), propertyCommands.end(), cmd) != propertyCommands.end();
+        if (args.size() == 1 && isPropertyCommand) {
+            source = Completion::Properties;
+        } else if ((args.size() == 2 && cmd == "set") || (args.size() >= 2 && cmd == "cycle-values")) {
+            source = Completion::Choices;
+            context = args[1];
+        }
+    }
+
+    const WordIndex* index = nullptr;
+    switch (source) {
+        case Completion::Commands:
+            index = &c.commands;
+            break;
+        case Completion::Properties:
+            index = &c.properties;
+            break;
+        case Completion::Choices: {
+            auto [it, inserted] = c.choices.try_emplace(context);
+            if (inserted) {
+                std::vector<std::string> texts;
+                mpv_node node{0};
+                auto name = fmt::format("option-info/{}", context);
+                if (mpv_get_property(mpv, name.c_str(), MPV_FORMAT_NODE, &node) >= 0) {
+                    if (node.format == MPV_FORMAT_NODE_MAP) {
+                        for (int i = 0; i < node.u.list->num; i++) {
+                            auto key = node.u.list->keys[i];
+                            auto value = node.u.list->values[i];
+                            if (strcmp(key, "type") == 0 && value.format == MPV_FORMAT_STRING &&
+                                strcmp(value.u.string, "Flag") == 0) {
+                                texts.emplace_back("yes");
+                                texts.emplace_back("no");
+                            } else if (strcmp(key, "choices") == 0 && value.format == MPV_FORMAT_NODE_ARRAY) {
+                                for (int j = 0; j < value.u.list->num; j++) {
+                                    auto choice = value.u.list->values[j];
+                                    if (choice.format == MPV_FORMAT_STRING) texts.emplace_back(choice.u.string);
+                                }
+                            }
+                        }
+                    }
+                    mpv_free_node_contents(&node);
+                }
+                it->second.build(std::move(texts));
+            }
+            index = &it->second;
+            break;
+        }
+        default:
+            break;
+    }
+
+    auto query = toLower(std::string_view(buf + start, cursor - start));
+    if (index == nullptr || index->words.empty()) {
+        c.matches.clear();
+        c.index = nullptr;
+        c.visible = false;
+        return;
+    }
+
+    // while typing, the new query only narrows the previous matches
+    std::vector<Completion::Match> matches;
+    if (c.index == index && c.source == source && c.context == context && query.starts_with(c.query)) {
+        for (auto& m : c.matches) {
+            int score = fuzzyScore(query, m.word->lower);
+            if (score >= 0) matches.push_back({score, m.word});
+        }
+    } else {
+        auto& words = index->words;
+        auto lo = std::lower_bound(words.begin(), words.end(), query,
+                                   [](auto& word, auto& q) { return word.lower < q; });
+        auto hi = std::partition_point(lo, words.end(), [&](auto& word) { return word.lower.starts_with(query); });
+        for (auto it = lo; it != hi; ++it) matches.push_back({fuzzyScore(query, it->lower), &*it});
+        if (!query.empty()) {
+            for (auto it = words.begin(); it != words.end(); ++it) {
+                if (it == lo) it = hi;
+                if (it == words.end()) break;
+                int score = fuzzyScore(query, it->lower);
+                if (score >= 0) matches.push_back({score, &*it});
+            }
+        }
+    }
+    std::stable_sort(matches.begin(), matches.end(), [](auto& a, auto& b) {
+        if (a.score != b.score) return a.score > b.score;
+        return a.word->lower.size() < b.word->lower.size();
+    });
+
+    c.matches = std::move(matches);
+    c.index = index;
+    c.source = source;
+    c.context = context;
+    c.query = query;
+    c.wordStart = start;
+    c.cursor = cursor;
+    c.selected = 0;
+    c.scrollToSelected = true;
+    c.visible = !c.matches.empty() && (force || !query.empty()) &&
+                !(c.matches.size() == 1 && c.matches[0].word->lower == query);
+}
+
+void Debug::Console::drawCompletion(bool active) {
+    auto& c = Completer;
+    if (!c.visible || c.matches.empty() || (!active && !c.hovered)) {
+        c.hovered = false;
+        return;
+    }
+
+    ImVec2 pos = ImGui::GetItemRectMin();
+    float width = ImGui::GetItemRectSize().x;
+    int rows = std::min((int)c.matches.size(), 10);
+    ImGui::SetNextWindowPos(pos, ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+    ImGuiWindowFlags flags = ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize |
+                             ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+                             ImGuiWindowFlags_NoNav | ImGuiWindowFlags_AlwaysAutoResize;
+    int accepted = -1;
+    if (ImGui::Begin("##Completion", nullptr, flags)) {
+        ImGui::BringWindowToDisplayFront(ImGui::GetCurrentWindow());
+        ImVec2 size(width, ImGui::GetTextLineHeightWithSpacing() * rows + ImGui::GetStyle().WindowPadding.y);
+        if (ImGui::BeginChild("##Candidates", size)) {
+            ImGuiListClipper clipper;
+            clipper.Begin((int)c.matches.size());
+            if (c.scrollToSelected) clipper.IncludeItemByIndex(c.selected);
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                    ImGui::PushID(i);
+                    if (ImGui::Selectable(c.matches[i].word->text.c_str(), i == c.selected)) accepted = i;
+                    if (i == c.selected && c.scrollToSelected) {
+                        ImGui::SetScrollHereY();
+                        c.scrollToSelected = false;
+                    }
+                    ImGui::PopID();
+                }
+            }
+        }
+        ImGui::EndChild();
+        ImGui::TextDisabled("%d matches, TAB to complete", (int)c.matches.size());
+        c.hovered = ImGui::IsWindowHovered(ImGuiHoveredFlags_ChildWindows);
+    }
+    ImGui::End();
+
+    if (accepted >= 0) {
+        std::string line(InputBuf, c.wordStart);
+        line += c.matches[accepted].word->text + " ";
+        int cursor = (int)line.size();
+        line += InputBuf + c.cursor;
+        ImStrncpy(InputBuf, line.c_str(), IM_ARRAYSIZE(InputBuf));
+        UpdateCandidates(InputBuf, std::min(cursor, (int)strlen(InputBuf)), false);
+        ReclaimFocus = true;
+    }
 }
 
 void Debug::Console::ClearLog() {
-    for (int i = 0; i < Items.Size; i++) free(Items[i].Str);
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    FirstSeq += Items.Size;
+    for (int i = 0; i < Items.Size; i++) IM_FREE(Items[i].Str);
     Items.clear();
 }
 
@@ -386,14 +1094,31 @@ void Debug::Console::AddLog(const char* level, const char* fmt, ...) {
     va_end(copy);
 
     char buf[size + 1];
-    std::vsnprintf(buf, size, fmt, args);
+    std::vsnprintf(buf, size + 1, fmt, args);
     buf[size] = '\0';
     va_end(args);
 
-    Items.push_back({ImStrdup(buf), level});
+    ImGuiID hash = ImHashStr(buf, 0, ImHashStr(level));
+    std::lock_guard<std::mutex> lock(ItemsLock);
+    int64_t now = mpv_get_time_us(mpv);  // taken under the lock so First stays sorted for binary searches
+    Memory::Scope scope(MemTag::Log);
+
+    // repeats of one of the last few lines only bump its counter
+    if (Collapse) {
+        for (int i = Items.Size - 1; i >= 0 && i >= Items.Size - CollapseWindow; i--) {
+            auto& item = Items[i];
+            if (item.Hash != hash || strcmp(item.Lev, level) != 0 || strcmp(item.Str, buf) != 0) continue;
+            item.Count++;
+            item.Last = now;
+            return;
+        }
+    }
+
+    Items.push_back({ImStrdup(buf), level, hash, 1, now, now});
     if (Items.Size > LogLimit) {
         int offset = Items.Size - LogLimit;
-        for (int i = 0; i < offset; i++) free(Items[i].Str);
+        FirstSeq += offset;
+        for (int i = 0; i < offset; i++) IM_FREE(Items[i].Str);
         Items.erase(Items.begin(), Items.begin() + offset);
     }
 }
@@ -418,6 +1143,12 @@ void Debug::Console::draw() {
     }
     ImGui::SameLine();
     ImGui::TextDisabled("(%d/%d)", Items.Size, LogLimit);
+    if (Collapse && ImGui::IsItemHovered(ImGuiHoveredFlags_DelayShort)) {
+        std::lock_guard<std::mutex> lock(ItemsLock);
+        int64_t total = 0;
+        for (int i = 0; i < Items.Size; i++) total += Items[i].Count;
+        ImGui::SetTooltip("%lld messages in %d lines", (long long)total, Items.Size);
+    }
     ImGui::SameLine();
     ImGui::TextUnformatted("Level:");
     ImGui::SameLine();
@@ -437,42 +1168,117 @@ void Debug::Console::draw() {
     ImGui::TextUnformatted("Search:");
     ImGui::SameLine();
     Filter.Draw(fmt::format("{}##log", "##Search").c_str(), 0);
+
+    static const char* timeModes[] = {"Off", "Relative", "Absolute"};
+    ImGui::TextUnformatted("Time:");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::EmSize(6));
+    ImGui::Combo("##Time", &TimeColumn, timeModes, IM_ARRAYSIZE(timeModes));
+    ImGui::SameLine();
+    ImGui::TextUnformatted("Range:");
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayShort))
+        ImGui::SetTooltip("Seconds since start, or a clock time as hh:mm:ss[.fff]");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::EmSize(5));
+    ImGui::InputTextWithHint("##From", "from", RangeBuf[0], IM_ARRAYSIZE(RangeBuf[0]));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::EmSize(5));
+    ImGui::InputTextWithHint("##To", "to", RangeBuf[1], IM_ARRAYSIZE(RangeBuf[1]));
+    ImGui::SameLine();
+    ImGui::TextUnformatted("Jump:");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::EmSize(5));
+    if (ImGui::InputTextWithHint("##Jump", "time", JumpBuf, IM_ARRAYSIZE(JumpBuf),
+                                 ImGuiInputTextFlags_EnterReturnsTrue))
+        JumpTime = ParseTime(JumpBuf, INT64_MIN);
+    if (Exporter.running) {
+        size_t total = Exporter.total, done = Exporter.done;
+        ImGui::TextUnformatted("Exporting:");
+        ImGui::SameLine();
+        ImGui::ProgressBar(total > 0 ? (float)done / total : 0.0f, ImVec2(ImGui::EmSize(12), 0),
+                           fmt::format("{}/{}", done, total).c_str());
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel##Export")) Exporter.cancel = true;
+    }
     ImGui::Separator();
 
     const float footer_height_to_reserve = ImGui::GetStyle().ItemSpacing.y + ImGui::GetFrameHeightWithSpacing();
-    bool copy_to_clipboard = false;
+    bool open_export = false;
     if (ImGui::BeginChild("ScrollingRegion", ImVec2(0, -footer_height_to_reserve), ImGuiChildFlags_None,
                           ImGuiWindowFlags_HorizontalScrollbar)) {
         if (ImGui::BeginPopupContextWindow()) {
             ImGui::MenuItem("Auto-scroll", nullptr, &AutoScroll);
+            ImGui::MenuItem("Collapse duplicates", nullptr, &Collapse);
+            ImGui::SetNextItemWidth(ImGui::EmSize(8));
+            ImGui::SliderFloat("Gap highlight", &GapThreshold, 0.1f, 10.0f, "%.1f s");
             if (ImGui::MenuItem("Clear")) ClearLog();
-            ImGui::MenuItem("Copy", nullptr, &copy_to_clipboard);
+            if (ImGui::MenuItem("Copy")) CopyToClipboard();
+            if (ImGui::MenuItem("Export...", nullptr, false, !Exporter.running)) open_export = true;
             ImGui::EndPopup();
         }
 
         ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(4, 1));
-        if (copy_to_clipboard) ImGui::LogToClipboard();
-        for (int i = 0; i < Items.Size; i++) {
-            auto item = Items[i];
-            if (!Filter.PassFilter(item.Str)) continue;
+        std::unique_lock<std::mutex> lock(ItemsLock);
+        UpdateView();
+        auto& seqs = View.seqs;
+        bool jumped = JumpTime != INT64_MIN;
+        if (jumped) {
+            auto it = std::partition_point(seqs.begin(), seqs.end(),
+                                           [&](uint64_t seq) { return Items[(int)(seq - FirstSeq)].First < JumpTime; });
+            ImGui::SetScrollY((it - seqs.begin()) * ImGui::GetTextLineHeightWithSpacing());
+            JumpTime = INT64_MIN;
+        }
 
-            ImGui::PushStyleColor(ImGuiCol_Text, LogColor(item.Lev));
-            ImGui::TextUnformatted(item.Str);
-            ImGui::PopStyleColor();
+        ImGuiListClipper clipper;
+        clipper.Begin((int)seqs.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                int i = (int)(seqs[row] - FirstSeq);
+                auto& item = Items[i];
+
+                if (TimeColumn != TimeOff) {
+                    char time[32];
+                    FormatTime(time, sizeof(time), item.First);
+                    int64_t gap = i > 0 ? item.First - Items[i - 1].Last : 0;
+                    if (gap >= GapThreshold * 1e6) {
+                        ImGui::TextColored(LogColor("warn"), "%s", time);
+                        if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayShort))
+                            ImGui::SetTooltip("%.3fs after the previous line", gap / 1e6);
+                    } else {
+                        ImGui::TextDisabled("%s", time);
+                    }
+                    ImGui::SameLine();
+                }
+                if (item.Count > 1) {
+                    ImGui::TextDisabled("x%d", item.Count);
+                    if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayShort))
+                        ImGui::SetTooltip("Repeated %d times\nFirst: %.3fs\nLast: %.3fs", item.Count,
+                                          (item.First - StartTime) / 1e6, (item.Last - StartTime) / 1e6);
+                    ImGui::SameLine();
+                }
+                ImGui::PushStyleColor(ImGuiCol_Text, LogColor(item.Lev));
+                ImGui::TextUnformatted(item.Str);
+                ImGui::PopStyleColor();
+            }
         }
-        if (copy_to_clipboard) ImGui::LogFinish();
+        clipper.End();
+        lock.unlock();
 
-        if (ScrollToBottom || (AutoScroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()))
+        if (!jumped && (ScrollToBottom || (AutoScroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY())))
             ImGui::SetScrollHereY(1.0f);
         ScrollToBottom = false;
         ImGui::PopStyleVar();
     }
     ImGui::EndChild();
+    drawExport(open_export);
     ImGui::Separator();
 
     bool reclaim_focus = false;
     ImGuiInputTextFlags input_text_flags = ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_EscapeClearsAll |
-                                           ImGuiInputTextFlags_CallbackCompletion | ImGuiInputTextFlags_CallbackHistory;
+                                           ImGuiInputTextFlags_CallbackCompletion |
+                                           ImGuiInputTextFlags_CallbackHistory | ImGuiInputTextFlags_CallbackEdit;
+    if (ReclaimFocus) ImGui::SetKeyboardFocusHere();
+    ReclaimFocus = false;
     if (ImGui::InputTextWithHint(
             "Command", "press ENTER to execute", InputBuf, IM_ARRAYSIZE(InputBuf), input_text_flags,
             [](ImGuiInputTextCallbackData* data) {
@@ -485,7 +1291,10 @@ void Debug::Console::draw() {
         if (s[0]) ExecCommand(s);
         strcpy(s, "");
         reclaim_focus = true;
+        Completer.visible = false;
+        Completer.index = nullptr;
     }
+    drawCompletion(ImGui::IsItemActive());
 
     ImGui::SetItemDefaultFocus();
     if (reclaim_focus) ImGui::SetKeyboardFocusHere(-1);  // Auto focus previous widget
@@ -500,13 +1309,170 @@ void Debug::Console::draw() {
     }
 }
 
+// seconds since start, or a local clock time as [hh:]mm:ss[.fff] on the day the console started
+int64_t Debug::Console::ParseTime(const char* str, int64_t fallback) {
+    while (*str == ' ') str++;
+    if (*str == '\0') return fallback;
+
+    if (strchr(str, ':')) {
+        time_t start = (StartTime + WallOffset) / 1000000;
+        std::tm tm = *std::localtime(&start);
+        int h, m;
+        double sec;
+        if (sscanf(str, "%d:%d:%lf", &h, &m, &sec) == 3) {
+            tm.tm_hour = h;
+            tm.tm_min = m;
+        } else if (sscanf(str, "%d:%lf", &m, &sec) == 2) {
+            tm.tm_min = m;
+        } else {
+            return fallback;
+        }
+        tm.tm_sec = 0;
+        return (int64_t)std::mktime(&tm) * 1000000 + (int64_t)(sec * 1e6) - WallOffset;
+    }
+
+    char* end = nullptr;
+    double sec = strtod(str, &end);
+    if (end == str) return fallback;
+    return StartTime + (int64_t)(sec * 1e6);
+}
+
+void Debug::Console::FormatTime(char* buf, size_t size, int64_t time) {
+    if (TimeColumn == TimeAbsolute) {
+        int64_t wall = time + WallOffset;
+        time_t sec = wall / 1000000;
+        size_t n = strftime(buf, size, "%H:%M:%S", std::localtime(&sec));
+        snprintf(buf + n, size - n, ".%03d", (int)(wall / 1000 % 1000));
+    } else {
+        snprintf(buf, size, "%10.3f", (time - StartTime) / 1e6);
+    }
+}
+
+// brings the filtered view up to date, ItemsLock must be held. Lines are
+// sorted by First, so the start of a time range is found by binary search
+// and lines past its end stop the scan
+void Debug::Console::UpdateView() {
+    auto& v = View;
+    int64_t from = ParseTime(RangeBuf[0], INT64_MIN);
+    int64_t to = ParseTime(RangeBuf[1], INT64_MAX);
+    if (!v.valid || v.filter != Filter.InputBuf || v.from != from || v.to != to) {
+        v.valid = true;
+        v.filter = Filter.InputBuf;
+        v.from = from;
+        v.to = to;
+        v.seqs.clear();
+        auto it = std::partition_point(Items.begin(), Items.end(), [&](const LogItem& item) { return item.First < from; });
+        v.end = FirstSeq + (it - Items.begin());
+    }
+
+    v.seqs.erase(v.seqs.begin(), std::lower_bound(v.seqs.begin(), v.seqs.end(), FirstSeq));
+    uint64_t end = FirstSeq + Items.Size;
+    for (uint64_t seq = std::max(v.end, FirstSeq); seq < end; seq++) {
+        auto& item = Items[(int)(seq - FirstSeq)];
+        if (item.First > to) break;
+        if (Filter.PassFilter(item.Str)) v.seqs.push_back(seq);
+    }
+    v.end = end;
+}
+
+static void appendLine(std::string& out, const char* str, int count) {
+    out += str;
+    if (!out.empty() && out.back() == '\n') out.pop_back();
+    if (count > 1) out += fmt::format(" [x{}]", count);
+    out += '\n';
+}
+
+void Debug::Console::CopyToClipboard() {
+    std::string text;
+    int lines = 0;
+    {
+        std::lock_guard<std::mutex> lock(ItemsLock);
+        for (int i = 0; i < Items.Size; i++) {
+            if (!Filter.PassFilter(Items[i].Str)) continue;
+            if (++lines > ClipboardLines) break;
+            appendLine(text, Items[i].Str, Items[i].Count);
+        }
+    }
+    if (lines > ClipboardLines) {
+        AddLog("error", "Too many lines for the clipboard (> %d), use Export instead", ClipboardLines);
+        return;
+    }
+    ImGui::SetClipboardText(text.c_str());
+}
+
+void Debug::Console::drawExport(bool open) {
+    if (open) ImGui::OpenPopup("Export Log");
+    if (!ImGui::BeginPopupModal("Export Log", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) return;
+    ImGui::TextUnformatted("File:");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::EmSize(20));
+    ImGui::InputText("##ExportPath", ExportPath, IM_ARRAYSIZE(ExportPath));
+    ImGui::Checkbox("Filtered lines only", &ExportFiltered);
+    if (ImGui::Button("Export")) {
+        StartExport(expandPath(mpv, ExportPath), ExportFiltered);
+        ImGui::CloseCurrentPopup();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) ImGui::CloseCurrentPopup();
+    ImGui::EndPopup();
+}
+
+// streams the lines present at start time to a file in chunks, so the
+// GUI thread never waits on disk I/O and AddLog() is only briefly blocked
+void Debug::Console::StartExport(std::string path, bool filtered) {
+    if (Exporter.running) return;
+    if (Exporter.thread.joinable()) Exporter.thread.join();
+
+    uint64_t begin, end;
+    {
+        std::lock_guard<std::mutex> lock(ItemsLock);
+        begin = FirstSeq;
+        end = FirstSeq + Items.Size;
+    }
+    Exporter.done = 0;
+    Exporter.total = end - begin;
+    Exporter.cancel = false;
+    Exporter.running = true;
+    Exporter.thread = std::thread([this, path, begin, end, pattern = std::string(filtered ? Filter.InputBuf : "")] {
+        ImGuiTextFilter filter(pattern.c_str());
+        std::ofstream file(path, std::ios::binary);
+        std::string chunk;
+        size_t lines = 0;
+        uint64_t seq = begin;
+        while (file && seq < end && !Exporter.cancel) {
+            {
+                std::lock_guard<std::mutex> lock(ItemsLock);
+                seq = std::max(seq, FirstSeq);  // lines evicted meanwhile are skipped
+                for (int n = 0; n < ExportChunk && seq < end && seq < FirstSeq + Items.Size; n++, seq++) {
+                    auto& item = Items[(int)(seq - FirstSeq)];
+                    if (!filter.PassFilter(item.Str)) continue;
+                    appendLine(chunk, item.Str, item.Count);
+                    lines++;
+                }
+                if (seq >= FirstSeq + Items.Size) seq = end;
+            }
+            file.write(chunk.data(), chunk.size());
+            chunk.clear();
+            Exporter.done = seq - begin;
+        }
+        file.close();
+        if (Exporter.cancel)
+            AddLog("warn", "[export] cancelled after %zu lines", lines);
+        else if (!file)
+            AddLog("error", "[export] failed to write %s", path.c_str());
+        else
+            AddLog("info", "[export] %zu lines written to %s", lines, path.c_str());
+        Exporter.running = false;
+    });
+}
+
 void Debug::Console::ExecCommand(const char* command_line) {
     AddLog("info", "# %s\n", command_line);
 
     HistoryPos = -1;
     for (int i = History.Size - 1; i >= 0; i--)
         if (ImStricmp(History[i], command_line) == 0) {
-            free(History[i]);
+            IM_FREE(History[i]);
             History.erase(History.begin() + i);
             break;
         }
@@ -527,6 +1493,42 @@ void Debug::Console::ExecCommand(const char* command_line) {
     } else if (ImStricmp(command_line, "HISTORY") == 0) {
         int first = History.Size - 10;
         for (int i = first > 0 ? first : 0; i < History.Size; i++) AddLog("info", "%3d: %s\n", i, History[i]);
+    } else if (ImStrnicmp(command_line, "BENCH", 5) == 0 && (command_line[5] == ' ' || command_line[5] == '\0')) {
+        const char* args = command_line + 5;
+        while (*args == ' ') args++;
+        char* end = nullptr;
+        long count = strtol(args, &end, 10);
+        if (ImStricmp(args, "STOP") == 0) {
+            StopBench();
+        } else if (count > 0 && end && *end == ' ' && end[1]) {
+            StartBench({end + 1}, (size_t)count);
+        } else {
+            AddLog("error", "Usage: BENCH <count> <command> | BENCH STOP");
+        }
+    } else if (ImStrnicmp(command_line, "RUN ", 4) == 0) {
+        auto args = splitCommand(command_line + 4);
+        long count = args.size() > 1 ? strtol(args[1].c_str(), nullptr, 10) : 1;
+        std::ifstream file(args.empty() ? "" : expandPath(mpv, args[0].c_str()));
+        if (!file || count <= 0) {
+            AddLog("error", "Usage: RUN <file> [count], file must be readable");
+        } else {
+            std::vector<std::string> script;
+            for (std::string line; std::getline(file, line);) {
+                line.erase(0, line.find_first_not_of(" \t"));
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (!line.empty() && line[0] != '#') script.push_back(line);
+            }
+            StartBench(std::move(script), (size_t)count);
+        }
+    } else if (ImStrnicmp(command_line, "WATCH", 5) == 0 && (command_line[5] == ' ' || command_line[5] == '\0')) {
+        auto args = splitCommand(command_line + 5);
+        if (args.empty())
+            ListWatches();
+        else
+            StartWatch(args);
+    } else if (ImStrnicmp(command_line, "UNWATCH", 7) == 0 && (command_line[7] == ' ' || command_line[7] == '\0')) {
+        auto args = splitCommand(command_line + 7);
+        StopWatch(args.empty() ? "" : args[0]);
     } else {
         int err = mpv_command_string(mpv, command_line);
         if (err < 0) {
@@ -539,62 +1541,347 @@ void Debug::Console::ExecCommand(const char* command_line) {
     ScrollToBottom = true;
 }
 
-int Debug::Console::TextEditCallback(ImGuiInputTextCallbackData* data) {
-    switch (data->EventFlag) {
-        case ImGuiInputTextFlags_CallbackCompletion: {
-            const char* word_end = data->Buf + data->CursorPos;
-            const char* word_start = word_end;
-            while (word_start > data->Buf) {
-                const char c = word_start[-1];
-                if (c == ' ' || c == '\t' || c == ',' || c == ';') break;
-                word_start--;
-            }
+void Debug::Console::StartBench(std::vector<std::string>&& lines, size_t repeat) {
+    std::lock_guard<std::mutex> lock(BenchLock);
+    if (Runner.running) {
+        AddLog("error", "A benchmark is already running, use BENCH STOP to abort it");
+        return;
+    }
+    std::erase_if(lines, [](auto& line) { return splitCommand(line.c_str()).empty(); });
+    if (lines.empty()) {
+        AddLog("error", "Nothing to run");
+        return;
+    }
+    if (repeat > SIZE_MAX / lines.size()) {
+        AddLog("error", "Too many repeats");
+        return;
+    }
+    Runner = Bench();
+    Runner.lines = std::move(lines);
+    Runner.total = Runner.lines.size() * repeat;
+    Runner.running = true;
+    Runner.startTime = mpv_get_time_us(mpv);
+    AddLog("info", "[bench] running %zu commands", Runner.total);
+    NextBench();
+}
 
-            ImVector<const char*> candidates;
-            for (int i = 0; i < Commands.Size; i++)
-                if (ImStrnicmp(Commands[i], word_start, (int)(word_end - word_start)) == 0)
-                    candidates.push_back(Commands[i]);
-
-            if (candidates.Size == 0) {
-                AddLog("info", "No match for \"%.*s\"!\n", (int)(word_end - word_start), word_start);
-            } else if (candidates.Size == 1) {
-                data->DeleteChars((int)(word_start - data->Buf), (int)(word_end - word_start));
-                data->InsertChars(data->CursorPos, candidates[0]);
-                data->InsertChars(data->CursorPos, " ");
-            } else {
-                int match_len = (int)(word_end - word_start);
-                for (;;) {
-                    int c = 0;
-                    bool all_candidates_matches = true;
-                    for (int i = 0; i < candidates.Size && all_candidates_matches; i++)
-                        if (i == 0)
-                            c = std::toupper(candidates[i][match_len]);
-                        else if (c == 0 || c != std::toupper(candidates[i][match_len]))
-                            all_candidates_matches = false;
-                    if (!all_candidates_matches) break;
-                    match_len++;
-                }
+void Debug::Console::StopBench() {
+    std::lock_guard<std::mutex> lock(BenchLock);
+    if (!Runner.running) return;
+    AddLog("warn", "[bench] aborted after %zu of %zu commands", Runner.next, Runner.total);
+    ReportBench();
+}
 
-                if (match_len > 0) {
-                    data->DeleteChars((int)(word_start - data->Buf), (int)(word_end - word_start));
-                    data->InsertChars(data->CursorPos, candidates[0], candidates[0] + match_len);
-                }
+// issues the next command, or reports when done; BenchLock must be held
+void Debug::Console::NextBench() {
+    static const std::vector<std::string> restartCommands = {
+        "seek",          "revert-seek",   "sub-seek",            "frame-back-step", "loadfile",
+        "playlist-next", "playlist-prev", "playlist-play-index",
+    };
+    auto& b = Runner;
+    while (b.next < b.total) {
+        auto& line = b.lines[b.next++ % b.lines.size()];
+        auto args = splitCommand(line.c_str());
+        if (args.empty()) continue;
 
-                AddLog("info", "Possible matches:\n");
-                std::string s;
-                for (int i = 0; i < candidates.Size; i++) {
-                    s += fmt::format("{:<32}", candidates[i]);
-                    if (i != 0 && (i + 1) % 3 == 0) {
-                        AddLog("info", "%s\n", s.c_str());
-                        s.clear();
-                    }
-                }
-                if (!s.empty()) AddLog("info", "%s\n", s.c_str());
-            }
+        std::vector<const char*> argv;
+        for (auto& arg : args) argv.push_back(arg.c_str());
+        argv.push_back(nullptr);
+
+        b.current = line;
+        b.waitRestart = std::find(restartCommands.begin(), restartCommands.end(), args[0]) != restartCommands.end();
+        b.replied = b.restarted = false;
+        b.id = ++BenchSeq;
+        b.start = mpv_get_time_us(mpv);
+        int err = mpv_command_async(mpv, b.id, argv.data());
+        if (err >= 0) return;
+        b.errors[line]++;
+    }
+    ReportBench();
+}
+
+void Debug::Console::BenchEvent(mpv_event* event) {
+    std::lock_guard<std::mutex> lock(BenchLock);
+    auto& b = Runner;
+    if (!b.running) return;
+
+    int64_t now = mpv_get_time_us(mpv);
+    if (event->event_id == MPV_EVENT_COMMAND_REPLY) {
+        if (event->reply_userdata != b.id || b.replied) return;
+        b.replied = true;
+        b.replyTime = now;
+        if (event->error < 0) {
+            b.errors[b.current]++;
+            NextBench();
+            return;
+        }
+    } else if (event->event_id == MPV_EVENT_PLAYBACK_RESTART) {
+        if (!b.waitRestart || b.restarted) return;
+        b.restarted = true;
+    } else {
+        // a file that fails to open never restarts playback, neither does a stuck command
+        bool failed = event->event_id == MPV_EVENT_END_FILE && b.waitRestart && !b.restarted &&
+                      ((mpv_event_end_file*)event->data)->reason == MPV_END_FILE_REASON_ERROR;
+        if (!failed && now - b.start <= Bench::Timeout) return;
+        AddLog("warn", "[bench] %s: %s", b.current.c_str(), failed ? "file failed to load" : "timed out");
+        b.errors[b.current]++;
+        NextBench();
+        return;
+    }
+    if (!b.replied || (b.waitRestart && !b.restarted)) return;
+
+    auto& sample = b.samples[b.current];
+    sample.reply.push_back((b.replyTime - b.start) / 1000.0);
+    if (b.waitRestart) sample.restart.push_back((now - b.start) / 1000.0);
+    NextBench();
+}
+
+// prints the latency distribution per command; BenchLock must be held
+void Debug::Console::ReportBench() {
+    auto& b = Runner;
+    auto print = [&](const std::string& name, const char* what, std::vector<double>& ms) {
+        if (ms.empty()) return;
+        std::sort(ms.begin(), ms.end());
+        double sum = 0;
+        for (double v : ms) sum += v;
+        auto pct = [&](double p) { return ms[std::min(ms.size() - 1, (size_t)std::ceil(p * ms.size()) - 1)]; };
+        AddLog("info", "[bench] %s (%s): n=%d min=%.3f p50=%.3f p90=%.3f p99=%.3f max=%.3f mean=%.3f ms",
+               name.c_str(), what, (int)ms.size(), ms.front(), pct(0.5), pct(0.9), pct(0.99), ms.back(),
+               sum / ms.size());
+    };
+    for (auto& [name, sample] : b.samples) {
+        print(name, "reply", sample.reply);
+        print(name, "playback-restart", sample.restart);
+    }
+    for (auto& [name, count] : b.errors) AddLog("error", "[bench] %s: %d failed", name.c_str(), count);
+    AddLog("info", "[bench] finished in %.3f s", (mpv_get_time_us(mpv) - b.startTime) / 1e6);
+    b.running = false;
+    ScrollToBottom = true;
+}
+
+void Debug::Console::StartWatch(const std::vector<std::string>& args) {
+    static const std::map<std::string, Watch::Op> ops = {
+        {"increases", Watch::Increases},
+        {"decreases", Watch::Decreases},
+        {"changes", Watch::Changes},
+        {"==", Watch::Eq},
+        {"!=", Watch::Ne},
+        {"<", Watch::Lt},
+        {"<=", Watch::Le},
+        {">", Watch::Gt},
+        {">=", Watch::Ge},
+    };
+    auto it = args.size() >= 2 ? ops.find(args[1]) : ops.end();
+    if (it == ops.end() || (it->second >= Watch::Eq) != (args.size() == 3)) {
+        AddLog("error", "Usage: WATCH <property> increases|decreases|changes");
+        AddLog("error", "       WATCH <property> ==|!=|<|<=|>|>= <value>");
+        return;
+    }
+
+    Watch w;
+    w.id = ++WatchSeq;
+    w.name = args[0];
+    w.op = it->second;
+    w.cond = fmt::format("{} {}", args[0], args[1]);
+    if (args.size() == 3) {
+        char* end = nullptr;
+        w.rhs = args[2];
+        w.number = strtod(w.rhs.c_str(), &end);
+        w.numeric = !w.rhs.empty() && *end == '\0';
+        w.cond += " " + w.rhs;
+    }
+    if (w.op >= Watch::Lt && !w.numeric) {
+        AddLog("error", "[watch] %s needs a numeric value", args[1].c_str());
+        return;
+    }
+    if (!Dumps.thread.joinable()) Dumps.thread = std::thread(&Console::WriteDumps, this);
+
+    uint64_t id = w.id;
+    auto cond = w.cond;
+    {
+        std::lock_guard<std::mutex> lock(WatchLock);
+        Watches.push_back(std::move(w));
+    }
+    int err = mpv_observe_property(mpv, id, args[0].c_str(), MPV_FORMAT_STRING);
+    if (err < 0) {
+        AddLog("error", "[watch] %s: %s", args[0].c_str(), mpv_error_string(err));
+        std::lock_guard<std::mutex> lock(WatchLock);
+        std::erase_if(Watches, [&](const Watch& w) { return w.id == id; });
+        return;
+    }
+    AddLog("info", "[watch] #%llu %s", (unsigned long long)id, cond.c_str());
+}
+
+void Debug::Console::StopWatch(const std::string& which) {
+    bool all = which.empty() || ImStricmp(which.c_str(), "ALL") == 0;
+    uint64_t id = all ? 0 : strtoull(which.c_str(), nullptr, 10);
+    std::lock_guard<std::mutex> lock(WatchLock);
+    int removed = (int)std::erase_if(Watches, [&](const Watch& w) {
+        if (!all && w.id != id) return false;
+        mpv_unobserve_property(mpv, w.id);
+        return true;
+    });
+    if (removed == 0)
+        AddLog("error", "Usage: UNWATCH [<id>|ALL], see WATCH for the list");
+    else
+        AddLog("info", "[watch] %d removed", removed);
+}
+
+void Debug::Console::ListWatches() {
+    std::lock_guard<std::mutex> lock(WatchLock);
+    if (Watches.empty()) AddLog("info", "[watch] nothing watched");
+    for (auto& w : Watches) {
+        const char* value = w.history.empty() ? "n/a" : w.history.back().value.c_str();
+        AddLog("info", "[watch] #%llu %s (now %s, fired %d)", (unsigned long long)w.id, w.cond.c_str(), value, w.fired);
+    }
+}
+
+// evaluates a watch on its property change; on a trigger the recent logs and
+// property history are copied out and handed to the dump thread
+void Debug::Console::WatchEvent(mpv_event* event) {
+    auto prop = (mpv_event_property*)event->data;
+    std::lock_guard<std::mutex> lock(WatchLock);
+    auto it = std::find_if(Watches.begin(), Watches.end(), [&](auto& w) { return w.id == event->reply_userdata; });
+    if (it == Watches.end()) return;
+
+    auto& w = *it;
+    int64_t now = mpv_get_time_us(mpv);
+    std::string value = prop->format == MPV_FORMAT_STRING ? *(char**)prop->data : "";
+    std::string prev = w.history.empty() ? "" : w.history.back().value;
+    w.history.push_back({now, value});
+    if (w.history.size() > WatchHistory) w.history.pop_front();
+
+    char* end = nullptr;
+    double v = strtod(value.c_str(), &end);
+    bool isNumber = !value.empty() && *end == '\0';
+    double p = strtod(prev.c_str(), &end);
+    bool prevNumber = !prev.empty() && *end == '\0';
+
+    bool holds = false;
+    switch (w.op) {
+        case Watch::Increases:
+            holds = isNumber && prevNumber && v > p;
+            break;
+        case Watch::Decreases:
+            holds = isNumber && prevNumber && v < p;
+            break;
+        case Watch::Changes:
+            holds = value != prev;
+            break;
+        case Watch::Eq:
+            holds = w.numeric ? isNumber && v == w.number : value == w.rhs;
+            break;
+        case Watch::Ne:
+            holds = w.numeric ? !isNumber || v != w.number : value != w.rhs;
+            break;
+        case Watch::Lt:
+            holds = isNumber && v < w.number;
+            break;
+        case Watch::Le:
+            holds = isNumber && v <= w.number;
+            break;
+        case Watch::Gt:
+            holds = isNumber && v > w.number;
+            break;
+        case Watch::Ge:
+            holds = isNumber && v >= w.number;
+            break;
+    }
+    bool fire = w.op <= Watch::Changes ? holds : holds && !w.active;
+    w.active = holds;
+    if (!w.primed) {
+        w.primed = true;
+        return;
+    }
+    if (!fire || now < w.holdoff) return;
+    w.holdoff = now + WatchWindow;
+    w.fired++;
+
+    Dump dump;
+    dump.path = fmt::format("~~/debug-watch-{}-{}.log", w.id, w.fired);
+    dump.header = fmt::format("watch #{} \"{}\" fired, {} = {} (was {})", w.id, w.cond, w.name, value, prev);
+    dump.time = now;
+    int64_t since = now - WatchWindow;
+    for (auto& other : Watches)
+        for (auto& sample : other.history)
+            if (sample.time >= since) dump.props.push_back({sample.time, other.name + " = " + sample.value, 1});
+    std::stable_sort(dump.props.begin(), dump.props.end(), [](auto& a, auto& b) { return a.time < b.time; });
+    {
+        std::lock_guard<std::mutex> lock(ItemsLock);
+        int first = Items.Size;
+        while (first > 0 && Items[first - 1].Last >= since) first--;
+        dump.lines.reserve(Items.Size - first);
+        for (int i = first; i < Items.Size; i++) dump.lines.push_back({Items[i].First, Items[i].Str, Items[i].Count});
+    }
+    {
+        std::lock_guard<std::mutex> lock(Dumps.lock);
+        Dumps.queue.push_back(std::move(dump));
+    }
+    Dumps.cv.notify_one();
+}
+
+// dump thread, drains the queue before exiting
+void Debug::Console::WriteDumps() {
+    std::unique_lock<std::mutex> lock(Dumps.lock);
+    while (true) {
+        Dumps.cv.wait(lock, [&] { return Dumps.quit || !Dumps.queue.empty(); });
+        if (Dumps.queue.empty()) return;
+        auto dump = std::move(Dumps.queue.front());
+        Dumps.queue.pop_front();
+        lock.unlock();
+
+        std::string text = "# " + dump.header + "\n\n# properties\n";
+        for (auto& line : dump.props) {
+            text += fmt::format("{:+.3f} ", (line.time - dump.time) / 1e6);
+            appendLine(text, line.text.c_str(), line.count);
+        }
+        text += fmt::format("\n# log, last {} s\n", WatchWindow / 1000000);
+        for (auto& line : dump.lines) {
+            text += fmt::format("{:+.3f} ", (line.time - dump.time) / 1e6);
+            appendLine(text, line.text.c_str(), line.count);
+        }
 
+        auto path = expandPath(mpv, dump.path.c_str());
+        std::ofstream file(path, std::ios::binary);
+        file.write(text.data(), text.size());
+        file.close();
+        if (file)
+            AddLog("warn", "[watch] %s, saved to %s", dump.header.c_str(), path.c_str());
+        else
+            AddLog("error", "[watch] %s, failed to write %s", dump.header.c_str(), path.c_str());
+        lock.lock();
+    }
+}
+
+int Debug::Console::TextEditCallback(ImGuiInputTextCallbackData* data) {
+    switch (data->EventFlag) {
+        case ImGuiInputTextFlags_CallbackCompletion: {
+            auto& c = Completer;
+            bool shown = c.visible;
+            if (!shown || c.cursor != data->CursorPos) UpdateCandidates(data->Buf, data->CursorPos, true);
+            if (c.matches.empty()) break;
+            if (!shown && c.matches.size() > 1) break;  // the first TAB only opens the popup
+
+            auto& word = c.matches[c.selected].word->text;
+            data->DeleteChars(c.wordStart, data->CursorPos - c.wordStart);
+            data->InsertChars(data->CursorPos, word.c_str());
+            data->InsertChars(data->CursorPos, " ");
+            UpdateCandidates(data->Buf, data->CursorPos, false);
             break;
         }
+        case ImGuiInputTextFlags_CallbackEdit:
+            UpdateCandidates(data->Buf, data->CursorPos, false);
+            break;
         case ImGuiInputTextFlags_CallbackHistory: {
+            auto& c = Completer;
+            if (c.visible) {
+                int count = (int)c.matches.size();
+                if (data->EventKey == ImGuiKey_UpArrow) c.selected = (c.selected + count - 1) % count;
+                if (data->EventKey == ImGuiKey_DownArrow) c.selected = (c.selected + 1) % count;
+                c.scrollToSelected = true;
+                break;
+            }
+
             const int prev_history_pos = HistoryPos;
             if (data->EventKey == ImGuiKey_UpArrow) {
                 if (HistoryPos == -1)
@@ -2,11 +2,21 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
 #include <mpv/client.h>
 #include <imgui.h>
+#include "memory.h"
 
 // imgui extensions
 namespace ImGui {
@@ -14,17 +24,151 @@ inline ImVec2 EmVec2(float x, float y) { return ImVec2(GetFontSize() * x, GetFon
 inline float EmSize(float n) { return GetFontSize() * n; }
 }  // namespace ImGui
 
+// append-only arena of interned strings, returned views are null-terminated
+// and stay valid for the lifetime of the pool
+class StringPool {
+   public:
+    std::string_view intern(std::string_view str);
+    size_t count() const { return index.size(); }
+    size_t bytes() const { return used; }
+
+   private:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[], MemoryDeleter>> chunks;
+    char *head = nullptr;
+    size_t offset = 0;
+    size_t used = 0;
+    std::unordered_set<std::string_view, std::hash<std::string_view>, std::equal_to<std::string_view>,
+                       TaggedAllocator<std::string_view, MemTag::Strings>>
+        index;
+};
+
+// publishes immutable snapshots from one writer thread to one reader thread:
+// the writer swaps a new version in, the reader picks up the latest one
+// without locking. Retired versions are freed when their last reference is
+// dropped, on whichever thread that happens.
+template <typename T>
+class Snapshot {
+   public:
+    Snapshot() : last(std::make_shared<T>()), current(last) {}
+    ~Snapshot() { delete pending.load(); }
+
+    // writer side
+    const std::shared_ptr<const T> &latest() const { return last; }
+    void publish(std::shared_ptr<const T> value) {
+        last = value;
+        delete pending.exchange(new std::shared_ptr<const T>(std::move(value)), std::memory_order_acq_rel);
+    }
+
+    // reader side, the returned reference is valid until the next acquire()
+    const std::shared_ptr<const T> &acquire() {
+        if (auto next = pending.exchange(nullptr, std::memory_order_acq_rel)) {
+            current = std::move(*next);
+            delete next;
+        }
+        return current;
+    }
+
+   private:
+    std::shared_ptr<const T> last;
+    std::atomic<std::shared_ptr<const T> *> pending = nullptr;
+    std::shared_ptr<const T> current;
+};
+
 class Debug {
    public:
-    Debug(mpv_handle *mpv, int logLines);
+    Debug(mpv_handle *mpv, int logLines, bool logCollapse = false);
     ~Debug();
 
     void draw();
     void show();
+    void hide();
+    bool isOpen();
+    bool busy();
+    bool benching();
     void AddLog(const char *prefix, const char *level, const char *text);
     void update(mpv_event_property *prop);
+    void handleEvent(mpv_event *event);
 
    private:
+    struct Name {
+        std::string_view name;
+        std::string_view lower;
+
+        template <typename F>
+        void visit(F &&f) {
+            f(name);
+            f(lower);
+        }
+    };
+
+    struct Command {
+        std::string_view name;
+        std::string_view args;
+        std::string_view lower;
+
+        template <typename F>
+        void visit(F &&f) {
+            f(name);
+            f(args);
+            f(lower);
+        }
+    };
+
+    // fields mpv leaves out stay "", so data() is always a valid C string
+    struct Binding {
+        std::string_view section = "";
+        std::string_view key = "";
+        std::string_view cmd = "";
+        std::string_view comment = "";
+        std::string_view keyLower = "";
+        std::string_view cmdLower = "";
+        int64_t priority = 0;
+        bool weak = false;
+
+        template <typename F>
+        void visit(F &&f) {
+            f(section);
+            f(key);
+            f(cmd);
+            f(comment);
+            f(keyLower);
+            f(cmdLower);
+        }
+    };
+
+    // cost of the last rebuild of a table
+    struct TableStats {
+        size_t updates = 0;
+        size_t rows = 0;
+        size_t reused = 0;
+        size_t changed = 0;
+        int64_t micros = 0;
+        size_t poolBytes = 0;
+    };
+
+    // rows of a list property, strings are interned in the table's pool so
+    // unchanged entries are reused across updates. Published tables are
+    // immutable, the next version shares the pool and only appends to it.
+    template <typename T>
+    struct Table {
+        std::vector<T> rows;
+        std::shared_ptr<StringPool> pool = std::make_shared<StringPool>();
+        TableStats stats;
+        uint64_t generation = 0;
+
+        // an empty successor sharing the pool, filled by commit()
+        std::shared_ptr<Table> next() const {
+            auto table = std::make_shared<Table>();
+            table->pool = pool;
+            table->stats = stats;
+            table->generation = generation;
+            return table;
+        }
+        void commit(std::vector<T> &&built, size_t changed, std::chrono::steady_clock::time_point start);
+    };
+
     struct Console {
         Console(mpv_handle *mpv, int logLines);
         ~Console();
@@ -36,46 +180,256 @@ class Debug {
         void AddLog(const char *level, const char *fmt, ...);
         void ExecCommand(const char *command_line);
         int TextEditCallback(ImGuiInputTextCallbackData *data);
-        void initCommands(std::vector<std::pair<std::string, std::string>> &commands);
+        void initCompletion(const Table<Command> &commands, const Table<Name> &options,
+                            const Table<Name> &properties);
+        void UpdateCandidates(const char *buf, int cursor, bool force);
+        void drawCompletion(bool active);
 
         ImVec4 LogColor(const char *level);
 
-        const std::vector<std::string> builtinCommands = {"HELP", "CLEAR", "HISTORY"};
+        int64_t ParseTime(const char *str, int64_t fallback);
+        void FormatTime(char *buf, size_t size, int64_t time);
+        void UpdateView();
+
+        void CopyToClipboard();
+        void drawExport(bool open);
+        void StartExport(std::string path, bool filtered);
+        void StartBench(std::vector<std::string> &&lines, size_t repeat);
+        void StopBench();
+        void NextBench();
+        void BenchEvent(mpv_event *event);
+        void ReportBench();
+        void StartWatch(const std::vector<std::string> &args);
+        void StopWatch(const std::string &which);
+        void ListWatches();
+        void WatchEvent(mpv_event *event);
+        void WriteDumps();
+
+        const std::vector<std::string> builtinCommands = {"HELP", "CLEAR", "HISTORY", "BENCH",
+                                                          "RUN",  "WATCH", "UNWATCH"};
 
         struct LogItem {
             char *Str;
             const char *Lev;
+            ImGuiID Hash;  // of level and text
+            int Count;     // > 1 when repeats were collapsed into this line
+            int64_t First;
+            int64_t Last;
+        };
+
+        static constexpr int CollapseWindow = 8;
+        static constexpr int ClipboardLines = 10000;
+        static constexpr int ExportChunk = 4096;
+        static constexpr int64_t WatchWindow = 10 * 1000000;  // us of history saved when a watch fires
+        static constexpr size_t WatchHistory = 256;           // values kept per watched property
+
+        enum TimeMode { TimeOff, TimeRelative, TimeAbsolute };
+
+        // filtered lines as sequence numbers, extended as lines arrive and
+        // rebuilt when the filter or time range changes
+        struct LogView {
+            std::vector<uint64_t> seqs;
+            uint64_t end = 0;  // next sequence number to scan
+            std::string filter;
+            int64_t from = 0;
+            int64_t to = 0;
+            bool valid = false;
+        };
+
+        struct Export {
+            std::thread thread;
+            std::atomic_bool running = false;
+            std::atomic_bool cancel = false;
+            std::atomic_size_t done = 0;
+            std::atomic_size_t total = 0;
+        };
+
+        // BENCH/RUN state, commands run one at a time through mpv_command_async
+        struct Bench {
+            struct Samples {
+                std::vector<double> reply;    // ms until the command reply
+                std::vector<double> restart;  // ms until PLAYBACK_RESTART, for seeks and file changes
+            };
+
+            static constexpr int64_t Timeout = 10000000;  // us a command may take before it counts as failed
+
+            std::vector<std::string> lines;  // the script, run repeatedly until total commands were issued
+            size_t total = 0;
+            size_t next = 0;
+            std::string current;
+            uint64_t id = 0;
+            int64_t start = 0;
+            int64_t replyTime = 0;
+            int64_t startTime = 0;
+            bool waitRestart = false;
+            bool replied = false;
+            bool restarted = false;
+            bool running = false;
+            std::map<std::string, Samples> samples;
+            std::map<std::string, int> errors;
+        };
+
+        // WATCH state, conditions are parsed once and evaluated on property change events
+        struct Watch {
+            enum Op { Increases, Decreases, Changes, Eq, Ne, Lt, Le, Gt, Ge };
+            struct Sample {
+                int64_t time;
+                std::string value;
+            };
+
+            uint64_t id;
+            std::string name;
+            std::string cond;  // as entered
+            Op op;
+            std::string rhs;
+            double number = 0;  // rhs, if numeric
+            bool numeric = false;
+            bool primed = false;  // the value reported on observe is only recorded
+            bool active = false;  // condition held on the last change, comparisons fire on edges
+            int64_t holdoff = 0;  // no dumps before this time
+            int fired = 0;
+            std::deque<Sample> history;
+        };
+
+        // log lines and property history frozen when a watch fired
+        struct Dump {
+            struct Line {
+                int64_t time;
+                std::string text;
+                int count;
+            };
+            std::string path;
+            std::string header;
+            int64_t time;
+            std::vector<Line> props;
+            std::vector<Line> lines;
+        };
+
+        struct Dumper {
+            std::thread thread;
+            std::mutex lock;
+            std::condition_variable cv;
+            std::deque<Dump> queue;
+            bool quit = false;
+        };
+
+        // sorted word list searched by prefix, with fuzzy matches ranked after it
+        struct WordIndex {
+            struct Word {
+                std::string lower;
+                std::string text;
+            };
+            std::vector<Word> words;
+            uint64_t generation = UINT64_MAX;
+
+            void build(std::vector<std::string> &&texts);
+        };
+
+        struct Completion {
+            enum Source { None, Commands, Properties, Choices };
+            struct Match {
+                int score;
+                const WordIndex::Word *word;
+            };
+
+            WordIndex commands;
+            WordIndex properties;
+            std::map<std::string, WordIndex> choices;  // option-info cache by option name
+            const WordIndex *index = nullptr;
+            Source source = None;
+            std::string context;
+            std::string query;
+            std::vector<Match> matches;
+            int wordStart = 0;
+            int cursor = 0;
+            int selected = 0;
+            bool visible = false;
+            bool hovered = false;
+            bool scrollToSelected = false;
         };
 
         mpv_handle *mpv;
         char InputBuf[256];
         ImVector<LogItem> Items;
-        ImVector<char *> Commands;
+        std::mutex ItemsLock;  // AddLog() is called from the mpv event thread
+        uint64_t FirstSeq = 0;  // sequence number of Items[0]
+        Export Exporter;
+        char ExportPath[512] = "~~/debug.log";
+        bool ExportFiltered = true;
+        Bench Runner;
+        std::mutex BenchLock;
+        uint64_t BenchSeq = 0;
+        std::vector<Watch> Watches;
+        std::mutex WatchLock;  // changes are evaluated on the mpv event thread
+        uint64_t WatchSeq = 0;
+        Dumper Dumps;
+        Completion Completer;
         ImVector<char *> History;
         int HistoryPos = -1;  // -1: new line, 0..History.Size-1 browsing history.
         ImGuiTextFilter Filter;
+        LogView View;
+        char RangeBuf[2][32] = {"", ""};
+        char JumpBuf[32] = "";
+        int64_t JumpTime = INT64_MIN;  // pending jump, in mpv time
+        int TimeColumn = TimeRelative;
+        float GapThreshold = 1.0f;  // seconds of silence before a line that get highlighted
+        int64_t WallOffset = 0;     // system clock minus mpv time, both in us
         bool AutoScroll = true;
         bool ScrollToBottom = false;
-        bool CommandInited = false;
+        bool ReclaimFocus = false;
         std::string LogLevel = "status";
         int LogLimit = 5000;
+        bool Collapse = false;
+        int64_t StartTime = 0;
     };
 
-    struct Binding {
-        std::string section;
-        std::string key;
-        std::string cmd;
-        std::string comment;
-        int64_t priority;
-        bool weak;
+    // formatted view of a property node, labels and values are only
+    // reformatted when the node changes
+    struct PropNode {
+        static constexpr int ChunkSize = 1000;
+        static constexpr int AutoOpenLimit = 100;
+
+        using String = std::basic_string<char, std::char_traits<char>, TaggedAllocator<char, MemTag::Nodes>>;
+
+        mpv_format format = MPV_FORMAT_NONE;
+        String name;
+        String label;
+        String value;
+        union {
+            int flag;
+            int64_t int64;
+            double double_;
+            size_t size;
+        } raw{0};
+        std::vector<PropNode, TaggedAllocator<PropNode, MemTag::Nodes>> children;
+        std::vector<String, TaggedAllocator<String, MemTag::Nodes>> chunks;
+        uint64_t generation = 0;  // bumped on every change, 0 until the first sync
+        bool open = false;
+        bool lazy = false;       // entries are fetched by sub-path on expansion
+        bool probed = false;     // <name>/count was queried
+        bool countable = false;  // <name>/count is available
     };
 
+    static void resizePropList(PropNode &cache, int count, bool isArray);
+    static void syncPropNode(PropNode &cache, mpv_node &node, bool relabel = false);
+    bool syncLazyList(PropNode &node);
+
+    void updateNames(Snapshot<Table<Name>> &table, mpv_node &node);
+    void updateCommands(Snapshot<Table<Command>> &table, mpv_node &node);
+    void updateBindings(Snapshot<Table<Binding>> &table, mpv_node &node);
+
     void drawHeader();
-    void drawConsole();
-    void drawBindings();
-    void drawCommands();
-    void drawProperties(const char *title, std::vector<std::string> &props);
-    void drawPropNode(const char *name, mpv_node &node, int depth = 0);
+    void drawConsole(const Table<Command> &commands, const Table<Name> &options, const Table<Name> &properties);
+    void drawBindings(const Table<Binding> &bindings);
+    void sortBindings(const Table<Binding> &bindings);
+    void drawCommands(const Table<Command> &commands);
+    void drawMemory();
+    void drawProperties(const char *title, const Table<Name> &props);
+    void drawTableStats(const TableStats &stats);
+    void drawPropNode(PropNode &node, int depth = 0);
+    void drawPropValue(PropNode &node);
+    void drawLazyChild(PropNode &list, int index);
+    void drawPropChildren(PropNode &node, int begin, int end, int depth);
 
     mpv_handle *mpv;
     bool m_open = true;
@@ -83,8 +437,20 @@ class Debug {
     std::string version;
     bool m_demo = false;
 
-    std::vector<std::string> options;
-    std::vector<std::string> properties;
-    std::vector<std::pair<std::string, std::string>> commands;
-    std::vector<Binding> bindings;
+    // built on the mpv event thread, read by the GUI thread
+    Snapshot<Table<Name>> m_options;
+    Snapshot<Table<Name>> m_properties;
+    Snapshot<Table<Command>> m_commands;
+    Snapshot<Table<Binding>> m_bindings;
+    std::map<std::string, std::map<std::string, PropNode>> propCache;  // by panel title and property name
+
+    // filtered and sorted row order of the bindings table, rebuilt only when
+    // the data, the sort specs or the filter text change
+    struct {
+        char filter[256] = "";
+        std::vector<ImGuiTableColumnSortSpecs> specs;
+        std::vector<int> rows;
+        uint64_t generation = 0;
+        bool dirty = true;
+    } bindingsView;
 };
@@ -1,9 +1,17 @@
 // Copyright (c) 2023 tsl0922. All rights reserved.
 // SPDX-License-Identifier: GPL-2.0-only
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
@@ -13,6 +21,8 @@
 #include <GLFW/glfw3.h>
 #include <mpv/client.h>
 #include "debug.h"
+#include "memory.h"
+#include "server.h"
 #include "main.h"
 
 std::thread thread;
@@ -20,6 +30,8 @@ static Config config;
 static mpv_handle* mpv = nullptr;
 static GLFWwindow* window = nullptr;
 static Debug* debug = nullptr;
+static Server* server = nullptr;
+static std::atomic_bool quit = false;
 
 static void glfw_error_callback(int error, const char* description) {
     fprintf(stderr, "GLFW Error %d: %s\n", error, description);
@@ -42,6 +54,27 @@ static const ImWchar* buildGlyphRanges() {
     return glyphRanges.Data;
 }
 
+// lowers the calling thread's priority while pre-warming, and puts back the
+// one it had. Only done where that needs no privileges: raising a nice value
+// back on Linux needs CAP_SYS_NICE, so elsewhere this does nothing.
+static void set_background_priority(bool background) {
+#ifdef _WIN32
+    static thread_local int prev = THREAD_PRIORITY_NORMAL;
+    if (background) prev = GetThreadPriority(GetCurrentThread());
+    SetThreadPriority(GetCurrentThread(), background ? THREAD_PRIORITY_BELOW_NORMAL : prev);
+#elif defined(__APPLE__)
+    static thread_local qos_class_t prev = QOS_CLASS_DEFAULT;
+    static thread_local int prevPriority = 0;
+    if (background) {
+        pthread_get_qos_class_np(pthread_self(), &prev, &prevPriority);
+        if (prev == QOS_CLASS_UNSPECIFIED) prev = QOS_CLASS_DEFAULT;
+    }
+    pthread_set_qos_class_self_np(background ? QOS_CLASS_UTILITY : prev, background ? 0 : prevPriority);
+#else
+    (void)background;
+#endif
+}
+
 static std::string mp_expand_path(const char* path) {
     std::string ret = path;
     mpv_node node{0};
@@ -54,8 +87,23 @@ static std::string mp_expand_path(const char* path) {
 }
 
 static int gui_thread() {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now(), last = start;
+    std::string phases;
+    auto phase = [&](const char* name) {
+        auto now = clock::now();
+        phases += fmt::format("{}{} {:.1f} ms", phases.empty() ? "" : ", ", name,
+                              std::chrono::duration<double, std::milli>(now - last).count());
+        last = now;
+    };
+    if (config.prewarm) set_background_priority(true);
+
     glfwSetErrorCallback(glfw_error_callback);
-    if (!glfwInit()) return 1;
+    if (!glfwInit()) {
+        debug->AddLog("gui", "error", "failed to initialize GLFW");
+        return 1;
+    }
+    phase("glfw");
 
 #ifdef __APPLE__
     const char* glsl_version = "#version 150";
@@ -71,9 +119,14 @@ static int gui_thread() {
     glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     window = glfwCreateWindow(400, 600, "Debug", nullptr, nullptr);
-    if (window == nullptr) return 1;
+    if (window == nullptr) {
+        debug->AddLog("gui", "error", "failed to create the window");
+        glfwTerminate();
+        return 1;
+    }
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
+    phase("window");
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -91,21 +144,45 @@ static int gui_thread() {
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
-
-    ImFontConfig font_cfg;
-    font_cfg.SizePixels = config.fontSize * scale;
-    if (config.fontPath.empty()) {
-        io.Fonts->AddFontDefault(&font_cfg);
-    } else {
-        const ImWchar* unicodeRanges = buildGlyphRanges();
-        io.Fonts->AddFontFromFileTTF(config.fontPath.c_str(), 0, &font_cfg, unicodeRanges);
+    phase("imgui");
+
+    {
+        Memory::Scope scope(MemTag::Fonts);
+        ImFontConfig font_cfg;
+        font_cfg.SizePixels = config.fontSize * scale;
+        if (config.fontPath.empty()) {
+            io.Fonts->AddFontDefault(&font_cfg);
+        } else {
+            const ImWchar* unicodeRanges = buildGlyphRanges();
+            io.Fonts->AddFontFromFileTTF(config.fontPath.c_str(), 0, &font_cfg, unicodeRanges);
+        }
+        // build the atlas here rather than lazily in the first NewFrame, so it is accounted to fonts
+        unsigned char* pixels;
+        int width, height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
     }
+    phase("fonts");
+    ImGui_ImplOpenGL3_CreateDeviceObjects();
+    phase("gl objects");
+
+    auto total = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    debug->AddLog("gui", "v", fmt::format("ready in {:.1f} ms ({})", total, phases).c_str());
+    if (config.prewarm) set_background_priority(false);
 
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+    bool shown = false;  // the last frame drew the debug window
+
+    while (!glfwWindowShouldClose(window) && !quit) {
+        if (debug->busy())
+            glfwWaitEventsTimeout(0.1);
+        else
+            glfwWaitEvents();
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwWaitEvents();
+        // stay idle while hidden, after one more frame has removed the window
+        if (!shown && !debug->isOpen()) continue;
+        shown = debug->isOpen();
 
+        Memory::newFrame();
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -114,6 +191,7 @@ static int gui_thread() {
         vp->Flags &= ~ImGuiViewportFlags_CanHostOtherWindows;
 
         debug->draw();
+        if (shown && !debug->isOpen()) glfwPostEmptyEvent();
 
         ImGui::Render();
         int display_w, display_h;
@@ -147,20 +225,28 @@ static int gui_thread() {
 }
 
 static void show_debug() {
-    if (!window) {
+    debug->show();
+    if (!thread.joinable())
         thread = std::thread(gui_thread);
-    } else {
-        debug->show();
+    else if (window)
         glfwPostEmptyEvent();
-    }
 }
 
 static void handle_property_change(mpv_event* event) {
+    if (event->reply_userdata != 0) {
+        debug->handleEvent(event);  // console watchpoints
+        return;
+    }
     mpv_event_property* prop = (mpv_event_property*)event->data;
     debug->update(prop);
     glfwPostEmptyEvent();
 }
 
+static void handle_command_event(mpv_event* event) {
+    debug->handleEvent(event);
+    if (window) glfwPostEmptyEvent();
+}
+
 static void handle_client_message(mpv_event* event) {
     mpv_event_client_message* msg = (mpv_event_client_message*)event->data;
     if (msg->num_args < 1) return;
@@ -185,6 +271,15 @@ static void load_config() {
     inipp::get_value(ini.sections[""], "font-path", config.fontPath);
     inipp::get_value(ini.sections[""], "font-size", config.fontSize);
     inipp::get_value(ini.sections[""], "log-lines", config.logLines);
+    inipp::get_value(ini.sections[""], "server", config.server);
+
+    std::string logCollapse;
+    inipp::get_value(ini.sections[""], "log-collapse", logCollapse);
+    config.logCollapse = logCollapse == "yes";
+
+    std::string prewarm;
+    inipp::get_value(ini.sections[""], "prewarm", prewarm);
+    config.prewarm = prewarm == "yes";
 }
 
 int mpv_open_cplugin(mpv_handle* handle) {
@@ -192,10 +287,26 @@ int mpv_open_cplugin(mpv_handle* handle) {
 
     load_config();
 
-    debug = new Debug(mpv, config.logLines);
+    // before anything is allocated with IM_ALLOC, log lines are added from this thread
+    Memory::install();
+    debug = new Debug(mpv, config.logLines, config.logCollapse);
+
+    if (!config.server.empty()) {
+        server = new Server(mpv, config.server);
+        if (!server->start()) {
+            debug->AddLog("server", "error", server->error().c_str());
+            delete server;
+            server = nullptr;
+        }
+    }
+
+    if (config.prewarm) {
+        debug->hide();
+        thread = std::thread(gui_thread);
+    }
 
     while (mpv) {
-        mpv_event* event = mpv_wait_event(mpv, -1);
+        mpv_event* event = mpv_wait_event(mpv, debug->benching() ? 0.5 : -1);
         if (event->event_id == MPV_EVENT_SHUTDOWN) break;
 
         switch (event->event_id) {
@@ -208,13 +319,21 @@ int mpv_open_cplugin(mpv_handle* handle) {
             case MPV_EVENT_LOG_MESSAGE:
                 handle_log_message(event);
                 break;
+            case MPV_EVENT_NONE:  // wait timeout, lets BENCH time out stuck commands
+            case MPV_EVENT_COMMAND_REPLY:
+            case MPV_EVENT_PLAYBACK_RESTART:
+            case MPV_EVENT_END_FILE:
+                handle_command_event(event);
+                break;
             default:
                 break;
         }
     }
 
     mpv_unobserve_property(mpv, 0);
+    delete server;
 
+    quit = true;
     if (window) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
         glfwPostEmptyEvent();
@@ -67,6 +67,9 @@ typedef struct {
     std::string fontPath;
     int fontSize = 13;
     int logLines = 5000;
+    bool logCollapse = false;
+    bool prewarm = false;
+    std::string server;
 } Config;
 
 extern "C" MPV_EXPORT int mpv_open_cplugin(mpv_handle* handle);
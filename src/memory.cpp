@@ -0,0 +1,130 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <imgui.h>
+#include "memory.h"
+
+namespace {
+constexpr size_t HeaderSize = 16;
+constexpr size_t SlabSize = 64 * 1024;
+constexpr size_t Classes[] = {32, 64, 128, 256, 512, 1024, 2048, 4096};  // block sizes, header included
+constexpr uint8_t Unpooled = 0xff;
+
+struct Header {
+    uint32_t size;
+    MemTag tag;
+    uint8_t cls;
+};
+static_assert(sizeof(Header) <= HeaderSize);
+
+struct Pool {
+    std::mutex lock;
+    void *free = nullptr;
+};
+
+struct Counters {
+    std::atomic_size_t live;
+    std::atomic_size_t peak;
+    std::atomic_size_t allocs;
+    std::atomic_size_t frees;
+    size_t lastAllocs;  // only touched by newFrame()
+    size_t frame;
+};
+
+Pool pools[std::size(Classes)];
+Counters counters[(int)MemTag::Count];
+std::atomic_size_t reservedBytes;
+thread_local MemTag currentTag = MemTag::ImGui;
+
+uint8_t sizeClass(size_t size) {
+    for (uint8_t i = 0; i < std::size(Classes); i++)
+        if (size <= Classes[i]) return i;
+    return Unpooled;
+}
+
+void *carve(uint8_t cls) {
+    auto &pool = pools[cls];
+    std::lock_guard<std::mutex> lock(pool.lock);
+    if (pool.free == nullptr) {
+        char *slab = (char *)std::malloc(SlabSize);
+        if (slab == nullptr) return nullptr;
+        reservedBytes += SlabSize;
+        for (size_t off = 0; off + Classes[cls] <= SlabSize; off += Classes[cls]) {
+            *(void **)(slab + off) = pool.free;
+            pool.free = slab + off;
+        }
+    }
+    void *block = pool.free;
+    pool.free = *(void **)block;
+    return block;
+}
+}  // namespace
+
+void *Memory::alloc(size_t size, MemTag tag) {
+    uint8_t cls = sizeClass(size + HeaderSize);
+    void *block = cls == Unpooled ? std::malloc(size + HeaderSize) : carve(cls);
+    if (block == nullptr) throw std::bad_alloc();
+
+    auto header = (Header *)block;
+    header->size = (uint32_t)size;
+    header->tag = tag;
+    header->cls = cls;
+
+    auto &c = counters[(int)tag];
+    size_t live = c.live += size;
+    size_t peak = c.peak;
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live)) {
+    }
+    c.allocs++;
+    return (char *)block + HeaderSize;
+}
+
+void Memory::free(void *ptr) {
+    if (ptr == nullptr) return;
+    auto header = (Header *)((char *)ptr - HeaderSize);
+    auto &c = counters[(int)header->tag];
+    c.live -= header->size;
+    c.frees++;
+
+    if (header->cls == Unpooled) {
+        std::free(header);
+        return;
+    }
+    auto &pool = pools[header->cls];
+    std::lock_guard<std::mutex> lock(pool.lock);
+    *(void **)header = pool.free;
+    pool.free = header;
+}
+
+void Memory::install() {
+    ImGui::SetAllocatorFunctions([](size_t size, void *) { return Memory::alloc(size, currentTag); },
+                                 [](void *ptr, void *) { Memory::free(ptr); });
+}
+
+void Memory::newFrame() {
+    for (auto &c : counters) {
+        size_t allocs = c.allocs;
+        c.frame = allocs - c.lastAllocs;
+        c.lastAllocs = allocs;
+    }
+}
+
+Memory::Stats Memory::stats(MemTag tag) {
+    auto &c = counters[(int)tag];
+    return {c.live, c.peak, c.allocs, c.frees, c.frame};
+}
+
+size_t Memory::reserved() { return reservedBytes; }
+
+const char *Memory::name(MemTag tag) {
+    static const char *names[] = {"ImGui", "Fonts", "Log", "Strings", "Nodes"};
+    return names[(int)tag];
+}
+
+Memory::Scope::Scope(MemTag tag) : prev(currentTag) { currentTag = tag; }
+
+Memory::Scope::~Scope() { currentTag = prev; }
@@ -0,0 +1,65 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// subsystems that memory is accounted to
+enum class MemTag : uint8_t { ImGui, Fonts, Log, Strings, Nodes, Count };
+
+// size-class pooled allocator with per-tag accounting, used for ImGui and
+// the plugin's own long-lived data
+namespace Memory {
+struct Stats {
+    size_t live;    // bytes currently allocated
+    size_t peak;    // highest live bytes seen
+    size_t allocs;  // allocations since start
+    size_t frees;
+    size_t frame;   // allocations during the last frame
+};
+
+void *alloc(size_t size, MemTag tag);
+void free(void *ptr);
+void install();  // routes ImGui allocations through the pool
+void newFrame();
+Stats stats(MemTag tag);
+size_t reserved();  // bytes held by the pools, in use or not
+const char *name(MemTag tag);
+
+// tags ImGui allocations made by this thread while in scope
+class Scope {
+   public:
+    explicit Scope(MemTag tag);
+    ~Scope();
+
+   private:
+    MemTag prev;
+};
+}  // namespace Memory
+
+struct MemoryDeleter {
+    void operator()(void *ptr) const { Memory::free(ptr); }
+};
+
+// stateless STL allocator accounting to a fixed tag
+template <typename T, MemTag Tag>
+struct TaggedAllocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = TaggedAllocator<U, Tag>;
+    };
+
+    TaggedAllocator() = default;
+    template <typename U>
+    TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+    T *allocate(size_t n) { return (T *)Memory::alloc(n * sizeof(T), Tag); }
+    void deallocate(T *p, size_t) { Memory::free(p); }
+
+    template <typename U>
+    bool operator==(const TaggedAllocator<U, Tag> &) const {
+        return true;
+    }
+};
@@ -0,0 +1,246 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "raster.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_SSE2
+#include <emmintrin.h>
+#endif
+
+// x * y / 255, rounded, exact for 8-bit inputs
+static inline uint32_t mul8(uint32_t x, uint32_t y) {
+    uint32_t t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t modulate(uint32_t a, uint32_t b) {
+    return mul8(a & 0xff, b & 0xff) | mul8((a >> 8) & 0xff, (b >> 8) & 0xff) << 8 |
+           mul8((a >> 16) & 0xff, (b >> 16) & 0xff) << 16 | mul8(a >> 24, b >> 24) << 24;
+}
+
+// src over dst: rgb = s * a + d * (1 - a), alpha = a + d * (1 - a), the
+// same as the OpenGL backend's glBlendFuncSeparate setup
+static inline uint32_t blend(uint32_t dst, uint32_t src) {
+    uint32_t a = src >> 24, inv = 255 - a;
+    auto channel = [&](int shift, uint32_t s) {
+        uint32_t t = s * a + ((dst >> shift) & 0xff) * inv + 128;
+        return ((t + (t >> 8)) >> 8) << shift;
+    };
+    return channel(0, src & 0xff) | channel(8, (src >> 8) & 0xff) | channel(16, (src >> 16) & 0xff) | channel(24, 255);
+}
+
+// blends one color over a run of pixels, four at a time with SSE2
+static void blendSpan(uint32_t *dst, int n, uint32_t src) {
+    uint32_t a = src >> 24;
+    if (a == 0) return;
+    if (a == 255) {
+        std::fill_n(dst, n, src);
+        return;
+    }
+    int i = 0;
+#ifdef RASTER_SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i inv = _mm_set1_epi16((short)(255 - a));
+    __m128i round = _mm_set1_epi16(128);
+    __m128i s = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)(src | 0xff000000)), zero);
+    s = _mm_mullo_epi16(s, _mm_set1_epi16((short)a));
+    s = _mm_add_epi16(_mm_unpacklo_epi64(s, s), round);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv), s);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv), s);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; i++) dst[i] = blend(dst[i], src);
+}
+
+template <typename T>
+static inline uint32_t sample(const T *tex, float u, float v) {
+    int x = std::clamp((int)(u * tex->width), 0, tex->width - 1);
+    int y = std::clamp((int)(v * tex->height), 0, tex->height - 1);
+    return tex->pixels[(size_t)y * tex->width + x];
+}
+
+static inline uint32_t packColor(float r, float g, float b, float a) {
+    auto c = [](float f) { return (uint32_t)std::clamp((int)(f + 0.5f), 0, 255); };
+    return c(r) | c(g) << 8 | c(b) << 16 | c(a) << 24;
+}
+
+bool Image::save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<char> row((size_t)width * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t p = pixels[(size_t)y * width + x];
+            row[x * 3] = (char)(p & 0xff);
+            row[x * 3 + 1] = (char)((p >> 8) & 0xff);
+            row[x * 3 + 2] = (char)((p >> 16) & 0xff);
+        }
+        file.write(row.data(), row.size());
+    }
+    return (bool)file;
+}
+
+bool Image::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int max = 0;
+    file >> magic >> width >> height >> max;
+    file.get();
+    if (!file || magic != "P6" || max != 255 || width <= 0 || height <= 0) return false;
+
+    std::vector<unsigned char> row((size_t)width * 3);
+    pixels.resize((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        if (!file.read((char *)row.data(), row.size())) return false;
+        for (int x = 0; x < width; x++)
+            pixels[(size_t)y * width + x] = row[x * 3] | row[x * 3 + 1] << 8 | row[x * 3 + 2] << 16 | 0xffu << 24;
+    }
+    return true;
+}
+
+Raster::Raster(int width, int height) {
+    fb.width = width;
+    fb.height = height;
+    fb.pixels.resize((size_t)width * height);
+}
+
+void Raster::clear(uint32_t color) { std::fill(fb.pixels.begin(), fb.pixels.end(), color); }
+
+ImTextureID Raster::addTexture(const uint32_t *pixels, int width, int height) {
+    auto tex = std::make_unique<Texture>();
+    tex->width = width;
+    tex->height = height;
+    tex->pixels.assign(pixels, pixels + (size_t)width * height);
+    textures.push_back(std::move(tex));
+    return (ImTextureID)textures.back().get();
+}
+
+void Raster::addFontAtlas(ImFontAtlas *atlas) {
+    unsigned char *pixels;
+    int width, height;
+    atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    atlas->SetTexID(addTexture((const uint32_t *)pixels, width, height));
+}
+
+void Raster::render(const ImDrawData *data) {
+    ImVec2 offset = data->DisplayPos;
+    ImVec2 scale = data->FramebufferScale;
+    for (int n = 0; n < data->CmdListsCount; n++) {
+        const ImDrawList *list = data->CmdLists[n];
+        for (auto &cmd : list->CmdBuffer) {
+            if (cmd.UserCallback != nullptr) {
+                if (cmd.UserCallback != ImDrawCallback_ResetRenderState) cmd.UserCallback(list, &cmd);
+                continue;
+            }
+            // same rounding as the OpenGL backend's glScissor call
+            Clip clip;
+            clip.x0 = std::max(0, (int)((cmd.ClipRect.x - offset.x) * scale.x));
+            clip.y0 = std::max(0, (int)((cmd.ClipRect.y - offset.y) * scale.y));
+            clip.x1 = std::min(fb.width, (int)((cmd.ClipRect.z - offset.x) * scale.x));
+            clip.y1 = std::min(fb.height, (int)((cmd.ClipRect.w - offset.y) * scale.y));
+            if (clip.x0 >= clip.x1 || clip.y0 >= clip.y1) continue;
+
+            auto tex = (const Texture *)cmd.GetTexID();
+            const ImDrawIdx *idx = list->IdxBuffer.Data + cmd.IdxOffset;
+            const ImDrawVert *vtx = list->VtxBuffer.Data + cmd.VtxOffset;
+            for (unsigned int i = 0; i + 2 < cmd.ElemCount; i += 3)
+                drawTriangle(vtx[idx[i]], vtx[idx[i + 1]], vtx[idx[i + 2]], offset, scale, tex, clip);
+        }
+    }
+}
+
+// Walks the covered rows and fills each span of pixel centers inside all
+// three edges. Spans are half-open on both axes, so triangles sharing an
+// edge, like the two halves of a quad, never touch a pixel twice. Most of
+// ImGui's geometry is flat colored (rects) or flat colored and textured
+// (glyphs); only the remaining triangles interpolate per pixel.
+void Raster::drawTriangle(const ImDrawVert &v0, const ImDrawVert &v1, const ImDrawVert &v2, ImVec2 offset,
+                          ImVec2 scale, const Texture *tex, const Clip &clip) {
+    const ImDrawVert *v[3] = {&v0, &v1, &v2};
+    ImVec2 p[3];
+    for (int i = 0; i < 3; i++)
+        p[i] = ImVec2((v[i]->pos.x - offset.x) * scale.x, (v[i]->pos.y - offset.y) * scale.y);
+
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+    if (area == 0.0f || !std::isfinite(area)) return;
+    if (area < 0) {
+        std::swap(v[1], v[2]);
+        std::swap(p[1], p[2]);
+        area = -area;
+    }
+
+    float minY = std::min({p[0].y, p[1].y, p[2].y}), maxY = std::max({p[0].y, p[1].y, p[2].y});
+    int y0 = std::max(clip.y0, (int)std::ceil(minY - 0.5f));
+    int y1 = std::min(clip.y1, (int)std::ceil(maxY - 0.5f));
+    if (y0 >= y1) return;
+
+    // edge i runs from p[i] to p[i + 1], inside is a * x + b * y + c >= 0
+    float ea[3], eb[3], ec[3];
+    for (int i = 0; i < 3; i++) {
+        const ImVec2 &a = p[i], &b = p[(i + 1) % 3];
+        ea[i] = a.y - b.y;
+        eb[i] = b.x - a.x;
+        ec[i] = a.x * b.y - b.x * a.y;
+    }
+
+    bool flatColor = v0.col == v1.col && v1.col == v2.col;
+    bool flatUV = v0.uv.x == v1.uv.x && v1.uv.x == v2.uv.x && v0.uv.y == v1.uv.y && v1.uv.y == v2.uv.y;
+    uint32_t flat = v0.col;
+    if (flatColor && flatUV && tex) flat = modulate(flat, sample(tex, v0.uv.x, v0.uv.y));
+
+    // attribute planes: u, v, r, g, b, a
+    float attr[3][6];
+    for (int i = 0; i < 3; i++) {
+        ImU32 c = v[i]->col;
+        float f[6] = {v[i]->uv.x, v[i]->uv.y, (float)(c & 0xff), (float)((c >> 8) & 0xff), (float)((c >> 16) & 0xff),
+                      (float)(c >> 24)};
+        std::copy(f, f + 6, attr[i]);
+    }
+    float dx[6], dy[6];
+    for (int k = 0; k < 6; k++) {
+        float d1 = attr[1][k] - attr[0][k], d2 = attr[2][k] - attr[0][k];
+        dx[k] = (d1 * (p[2].y - p[0].y) - d2 * (p[1].y - p[0].y)) / area;
+        dy[k] = (d2 * (p[1].x - p[0].x) - d1 * (p[2].x - p[0].x)) / area;
+    }
+
+    for (int y = y0; y < y1; y++) {
+        float yc = y + 0.5f;
+        float left = -INFINITY, right = INFINITY;
+        for (int i = 0; i < 3; i++) {
+            float rest = eb[i] * yc + ec[i];
+            if (ea[i] > 0)
+                left = std::max(left, -rest / ea[i]);
+            else if (ea[i] < 0)
+                right = std::min(right, -rest / ea[i]);
+        }
+        if (!(left < right)) continue;
+        int x0 = std::max(clip.x0, (int)std::ceil(std::max(left, -1.0f) - 0.5f));
+        int x1 = std::min(clip.x1, (int)std::ceil(std::min(right, (float)fb.width + 1) - 0.5f));
+        if (x0 >= x1) continue;
+
+        uint32_t *dst = fb.pixels.data() + (size_t)y * fb.width;
+        if (flatColor && (flatUV || !tex)) {
+            blendSpan(dst + x0, x1 - x0, flat);
+            continue;
+        }
+
+        float xc = x0 + 0.5f;
+        float a[6];
+        for (int k = 0; k < 6; k++) a[k] = attr[0][k] + dx[k] * (xc - p[0].x) + dy[k] * (yc - p[0].y);
+        for (int x = x0; x < x1; x++) {
+            uint32_t src = flatColor ? flat : packColor(a[2], a[3], a[4], a[5]);
+            if (tex) src = modulate(src, sample(tex, a[0], a[1]));
+            if (src >> 24) dst[x] = blend(dst[x], src);
+            for (int k = 0; k < 6; k++) a[k] += dx[k];
+        }
+    }
+}
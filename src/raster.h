@@ -0,0 +1,49 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <imgui.h>
+
+// 32-bit pixels in ImGui's IM_COL32 layout (R, G, B, A in memory)
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+
+    bool save(const std::string &path) const;  // binary PPM, alpha is dropped
+    bool load(const std::string &path);
+};
+
+// software renderer for ImDrawData, so frames can be drawn and compared
+// without a GPU. Follows the OpenGL backend: scissor clipping, straight
+// alpha blending and one texture per draw command, sampled nearest.
+class Raster {
+   public:
+    Raster(int width, int height);
+
+    const Image &target() const { return fb; }
+    void clear(uint32_t color);
+    ImTextureID addTexture(const uint32_t *pixels, int width, int height);
+    void addFontAtlas(ImFontAtlas *atlas);
+    void render(const ImDrawData *data);
+
+   private:
+    struct Texture {
+        int width;
+        int height;
+        std::vector<uint32_t> pixels;
+    };
+    struct Clip {
+        int x0, y0, x1, y1;
+    };
+
+    void drawTriangle(const ImDrawVert &v0, const ImDrawVert &v1, const ImDrawVert &v2, ImVec2 offset, ImVec2 scale,
+                      const Texture *tex, const Clip &clip);
+
+    Image fb;
+    std::vector<std::unique_ptr<Texture>> textures;
+};
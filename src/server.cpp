@@ -0,0 +1,540 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <fmt/format.h>
+#include "server.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#define poll WSAPoll
+#define close_socket closesocket
+#define socket_errno WSAGetLastError()
+#define SOCKET_WOULDBLOCK WSAEWOULDBLOCK
+#define INVALID_FD ((socket_t)INVALID_SOCKET)
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define close_socket close
+#define socket_errno errno
+#define SOCKET_WOULDBLOCK EWOULDBLOCK
+#define INVALID_FD ((socket_t)-1)
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const char *logLevels[] = {"fatal", "error", "warn", "info", "status", "v", "debug", "trace"};
+
+static int logLevelIndex(const char *level) {
+    for (int i = 0; i < (int)std::size(logLevels); i++)
+        if (strcmp(logLevels[i], level) == 0) return i;
+    return -1;
+}
+
+static bool setNonBlocking(socket_t fd) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static void jsonString(std::string &out, const char *str) {
+    out += '"';
+    for (const char *p = str; *p; p++) {
+        unsigned char ch = *p;
+        switch (ch) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (ch < 0x20)
+                    out += fmt::format("\\u{:04x}", ch);
+                else
+                    out += (char)ch;
+                break;
+        }
+    }
+    out += '"';
+}
+
+static void jsonNode(std::string &out, const mpv_node &node) {
+    switch (node.format) {
+        case MPV_FORMAT_STRING:
+        case MPV_FORMAT_OSD_STRING:
+            jsonString(out, node.u.string);
+            break;
+        case MPV_FORMAT_FLAG:
+            out += node.u.flag ? "true" : "false";
+            break;
+        case MPV_FORMAT_INT64:
+            out += fmt::format("{}", node.u.int64);
+            break;
+        case MPV_FORMAT_DOUBLE:
+            out += std::isfinite(node.u.double_) ? fmt::format("{}", node.u.double_) : "null";
+            break;
+        case MPV_FORMAT_NODE_ARRAY:
+        case MPV_FORMAT_NODE_MAP: {
+            bool isMap = node.format == MPV_FORMAT_NODE_MAP;
+            out += isMap ? '{' : '[';
+            for (int i = 0; i < node.u.list->num; i++) {
+                if (i > 0) out += ',';
+                if (isMap) {
+                    jsonString(out, node.u.list->keys[i]);
+                    out += ':';
+                }
+                jsonNode(out, node.u.list->values[i]);
+            }
+            out += isMap ? '}' : ']';
+            break;
+        }
+        default:
+            out += "null";
+            break;
+    }
+}
+
+// parses a flat JSON object, keeping only its string members
+static bool parseRequest(const std::string &line, std::map<std::string, std::string> &out) {
+    const char *p = line.c_str();
+    auto skip = [&] {
+        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    };
+    auto readString = [&](std::string &str) {
+        if (*p++ != '"') return false;
+        while (*p && *p != '"') {
+            if (*p == '\\') {
+                p++;
+                switch (*p) {
+                    case 'n':
+                        str += '\n';
+                        break;
+                    case 't':
+                        str += '\t';
+                        break;
+                    case 'r':
+                        str += '\r';
+                        break;
+                    case 'u':
+                        if (strlen(p) < 5) return false;
+                        str += (char)strtol(std::string(p + 1, 4).c_str(), nullptr, 16);
+                        p += 4;
+                        break;
+                    case '\0':
+                        return false;
+                    default:
+                        str += *p;
+                        break;
+                }
+                p++;
+            } else {
+                str += *p++;
+            }
+        }
+        return *p++ == '"';
+    };
+
+    skip();
+    if (*p++ != '{') return false;
+    skip();
+    if (*p == '}') return true;
+    for (;;) {
+        std::string key, value;
+        skip();
+        if (!readString(key)) return false;
+        skip();
+        if (*p++ != ':') return false;
+        skip();
+        if (*p == '"') {
+            if (!readString(value)) return false;
+            out[key] = value;
+        } else {
+            while (*p && *p != ',' && *p != '}') p++;
+        }
+        skip();
+        if (*p == '}') return true;
+        if (*p++ != ',') return false;
+    }
+}
+
+Server::Server(mpv_handle *mpv, std::string address)
+    : parent(mpv), address(std::move(address)), listenFd(INVALID_FD), wakeFd(INVALID_FD) {}
+
+Server::~Server() { stop(); }
+
+bool Server::fail(const std::string &msg) {
+    lastError = fmt::format("{}: {} ({})", address, msg, socket_errno);
+    if (listenFd != INVALID_FD) close_socket(listenFd);
+    if (wakeFd != INVALID_FD) close_socket(wakeFd);
+    listenFd = wakeFd = INVALID_FD;
+    return false;
+}
+
+bool Server::start() {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return fail("WSAStartup failed");
+#endif
+    if (address.starts_with("unix:")) {
+        auto path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) return fail("invalid socket path");
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd == INVALID_FD) return fail("socket failed");
+        // only replace a stale socket, never some other file at a mistyped path
+#ifdef _WIN32
+        DWORD attrs = GetFileAttributesA(path.c_str());
+        if (attrs != INVALID_FILE_ATTRIBUTES) {
+            if (!(attrs & FILE_ATTRIBUTE_REPARSE_POINT)) return fail("path exists");
+            DeleteFileA(path.c_str());
+        }
+#else
+        struct stat st;
+        if (lstat(path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) return fail("path exists");
+            unlink(path.c_str());
+        }
+#endif
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0) return fail("bind failed");
+    } else if (address.starts_with("tcp:")) {
+        int port = atoi(address.c_str() + 4);
+        if (port <= 0 || port > 65535) return fail("invalid port");
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd == INVALID_FD) return fail("socket failed");
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof(yes));
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0) return fail("bind failed");
+    } else {
+        return fail("expected unix:<path> or tcp:<port>");
+    }
+    if (listen(listenFd, 8) != 0 || !setNonBlocking(listenFd)) return fail("listen failed");
+
+    // a loopback datagram socket sending to itself wakes up poll() portably
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    wakeFd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (wakeFd == INVALID_FD || bind(wakeFd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(wakeFd, (sockaddr *)&addr, &len) != 0 || connect(wakeFd, (sockaddr *)&addr, len) != 0 ||
+        !setNonBlocking(wakeFd))
+        return fail("wakeup socket failed");
+
+    mpv = mpv_create_client(parent, fmt::format("{}-server", mpv_client_name(parent)).c_str());
+    if (mpv == nullptr) return fail("mpv_create_client failed");
+    mpv_set_wakeup_callback(mpv, [](void *d) { ((Server *)d)->wakeup(); }, this);
+
+    running = true;
+    thread = std::thread(&Server::run, this);
+    return true;
+}
+
+void Server::stop() {
+    if (!thread.joinable()) return;
+    running = false;
+    wakeup();
+    thread.join();
+
+    mpv_set_wakeup_callback(mpv, nullptr, nullptr);
+    mpv_destroy(mpv);
+    mpv = nullptr;
+
+    for (auto &client : clients) close_socket(client.fd);
+    clients.clear();
+    close_socket(listenFd);
+    close_socket(wakeFd);
+    listenFd = wakeFd = INVALID_FD;
+#ifdef _WIN32
+    if (address.starts_with("unix:")) DeleteFileA(address.c_str() + 5);
+    WSACleanup();
+#else
+    if (address.starts_with("unix:")) unlink(address.c_str() + 5);
+#endif
+}
+
+void Server::wakeup() {
+    char ch = 0;
+    ::send(wakeFd, &ch, 1, MSG_NOSIGNAL);
+}
+
+void Server::run() {
+    std::vector<pollfd> fds;
+    char buf[4096];
+
+    while (running) {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakeFd, POLLIN, 0});
+        for (auto &client : clients)
+            fds.push_back({client.fd, (short)(POLLIN | (client.out.empty() ? 0 : POLLOUT)), 0});
+        if (poll(fds.data(), (unsigned)fds.size(), -1) < 0 && socket_errno != EINTR) break;
+
+        if (fds[1].revents & POLLIN)
+            while (recv(wakeFd, buf, sizeof(buf), 0) > 0) {
+            }
+
+        while (mpv_event *event = mpv_wait_event(mpv, 0)) {
+            if (event->event_id == MPV_EVENT_NONE) break;
+            if (event->event_id == MPV_EVENT_SHUTDOWN) running = false;
+            handleEvent(event);
+        }
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            auto &client = clients[i];
+            auto revents = fds[i + 2].revents;
+            if (revents & (POLLERR | POLLHUP | POLLNVAL)) client.closed = true;
+            if (!client.closed && (revents & POLLIN)) {
+                for (;;) {
+                    int n = recv(client.fd, buf, sizeof(buf), 0);
+                    if (n > 0) {
+                        client.in.append(buf, n);
+                        continue;
+                    }
+                    if (n == 0 || socket_errno != SOCKET_WOULDBLOCK) client.closed = true;
+                    break;
+                }
+                size_t pos;
+                while (!client.closed && (pos = client.in.find('\n')) != std::string::npos) {
+                    auto line = client.in.substr(0, pos);
+                    client.in.erase(0, pos + 1);
+                    handleRequest(client, line);
+                }
+                if (client.in.size() > MaxLineBytes) client.closed = true;
+            }
+            if (!client.closed) flush(client);
+        }
+
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (!it->closed) {
+                ++it;
+                continue;
+            }
+            close_socket(it->fd);
+            for (auto &name : std::set<std::string>(it->props)) unobserve(*it, name);
+            it = clients.erase(it);
+            updateLogLevel();
+        }
+
+        if (fds[0].revents & POLLIN) {
+            socket_t fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) != INVALID_FD) {
+                if (!setNonBlocking(fd)) {
+                    close_socket(fd);
+                    continue;
+                }
+                clients.push_back({fd});
+            }
+        }
+    }
+}
+
+void Server::handleEvent(mpv_event *event) {
+    switch (event->event_id) {
+        case MPV_EVENT_LOG_MESSAGE: {
+            auto msg = (mpv_event_log_message *)event->data;
+            int level = logLevelIndex(msg->level);
+            std::string line;
+            for (auto &client : clients) {
+                if (level < 0 || level > client.logLevel) continue;
+                if (!client.modules.empty() &&
+                    std::none_of(client.modules.begin(), client.modules.end(),
+                                 [&](auto &m) { return strncmp(msg->prefix, m.c_str(), m.size()) == 0; }))
+                    continue;
+                if (line.empty()) {
+                    line = "{\"event\":\"log\",\"prefix\":";
+                    jsonString(line, msg->prefix);
+                    line += ",\"level\":";
+                    jsonString(line, msg->level);
+                    line += ",\"text\":";
+                    jsonString(line, msg->text);
+                    line += "}\n";
+                }
+                send(client, line);
+            }
+            break;
+        }
+        case MPV_EVENT_PROPERTY_CHANGE: {
+            auto prop = (mpv_event_property *)event->data;
+            std::string line;
+            for (auto &client : clients) {
+                if (!client.props.contains(prop->name)) continue;
+                if (line.empty()) {
+                    line = "{\"event\":\"property-change\",\"name\":";
+                    jsonString(line, prop->name);
+                    line += ",\"data\":";
+                    if (prop->format == MPV_FORMAT_NODE)
+                        jsonNode(line, *(mpv_node *)prop->data);
+                    else
+                        line += "null";
+                    line += "}\n";
+                }
+                send(client, line);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Server::handleRequest(Client &client, const std::string &line) {
+    std::map<std::string, std::string> req;
+    if (line.find_first_not_of(" \t\r") == std::string::npos) return;
+    if (!parseRequest(line, req) || !req.contains("cmd")) {
+        send(client, "{\"error\":\"invalid request\"}\n");
+        return;
+    }
+
+    auto &cmd = req["cmd"];
+    auto &name = req["name"];
+    if (cmd == "log") {
+        client.logLevel = req.contains("level") ? logLevelIndex(req["level"].c_str()) : logLevelIndex("info");
+        client.modules.clear();
+        for (size_t start = 0, end; start < req["module"].size(); start = end + 1) {
+            end = req["module"].find(',', start);
+            if (end == std::string::npos) end = req["module"].size();
+            if (end > start) client.modules.push_back(req["module"].substr(start, end - start));
+        }
+        updateLogLevel();
+    } else if (cmd == "observe" && !name.empty()) {
+        observe(client, name);
+    } else if (cmd == "unobserve" && !name.empty()) {
+        unobserve(client, name);
+    } else if (cmd == "get" && !name.empty()) {
+        mpv_node node{0};
+        int err = mpv_get_property(mpv, name.c_str(), MPV_FORMAT_NODE, &node);
+        std::string reply = "{\"event\":\"get\",\"name\":";
+        jsonString(reply, name.c_str());
+        reply += ",\"data\":";
+        if (err >= 0) {
+            jsonNode(reply, node);
+            mpv_free_node_contents(&node);
+        } else {
+            reply += "null";
+        }
+        reply += ",\"error\":";
+        jsonString(reply, mpv_error_string(err));
+        reply += "}\n";
+        send(client, reply);
+    } else {
+        send(client, "{\"error\":\"unknown command\"}\n");
+    }
+}
+
+// queues a line for the client, dropping it if the client fell too far behind.
+// The cap only applies to lines backing up behind others, so a single large
+// reply (a long playlist) still goes out to a client that keeps up.
+void Server::send(Client &client, std::string line) {
+    bool backlog = !client.out.empty();
+    if (client.dropped > 0) {
+        auto notice = fmt::format("{{\"event\":\"dropped\",\"count\":{}}}\n", client.dropped);
+        if (backlog && client.outBytes + notice.size() + line.size() > MaxQueueBytes) {
+            client.dropped++;
+            return;
+        }
+        client.outBytes += notice.size();
+        client.out.push_back(std::move(notice));
+        client.dropped = 0;
+    }
+    if (backlog && client.outBytes + line.size() > MaxQueueBytes) {
+        client.dropped++;
+        return;
+    }
+    client.outBytes += line.size();
+    client.out.push_back(std::move(line));
+}
+
+void Server::flush(Client &client) {
+    while (!client.out.empty()) {
+        auto &line = client.out.front();
+        int n = ::send(client.fd, line.data() + client.outOffset, (int)(line.size() - client.outOffset), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (socket_errno != SOCKET_WOULDBLOCK) client.closed = true;
+            return;
+        }
+        client.outOffset += n;
+        if (client.outOffset < line.size()) return;
+        client.outBytes -= line.size();
+        client.outOffset = 0;
+        client.out.pop_front();
+    }
+}
+
+void Server::observe(Client &client, const std::string &name) {
+    if (!client.props.insert(name).second) return;
+    auto it = observers.find(name);
+    if (it == observers.end()) {
+        // mpv sends the initial value for a new observer
+        uint64_t id = nextObserverId++;
+        observers[name] = {id, 1};
+        mpv_observe_property(mpv, id, name.c_str(), MPV_FORMAT_NODE);
+        return;
+    }
+    it->second.refs++;
+
+    mpv_node node{0};
+    std::string line = "{\"event\":\"property-change\",\"name\":";
+    jsonString(line, name.c_str());
+    line += ",\"data\":";
+    if (mpv_get_property(mpv, name.c_str(), MPV_FORMAT_NODE, &node) >= 0) {
+        jsonNode(line, node);
+        mpv_free_node_contents(&node);
+    } else {
+        line += "null";
+    }
+    line += "}\n";
+    send(client, line);
+}
+
+void Server::unobserve(Client &client, const std::string &name) {
+    if (client.props.erase(name) == 0) return;
+    auto it = observers.find(name);
+    if (it == observers.end() || --it->second.refs > 0) return;
+    mpv_unobserve_property(mpv, it->second.id);
+    observers.erase(it);
+}
+
+// mpv filters by the most verbose level any client asked for
+void Server::updateLogLevel() {
+    int level = -1;
+    for (auto &client : clients)
+        if (!client.closed) level = std::max(level, client.logLevel);
+    if (level == requestedLevel) return;
+    requestedLevel = level;
+    mpv_request_log_messages(mpv, level < 0 ? "no" : logLevels[level]);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2023 tsl0922. All rights reserved.
+// SPDX-License-Identifier: GPL-2.0-only
+
+#pragma once
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mpv/client.h>
+
+#ifdef _WIN32
+typedef uintptr_t socket_t;
+#else
+typedef int socket_t;
+#endif
+
+// Streams newline-delimited JSON to local clients over a unix socket or a
+// localhost TCP port. It runs on its own thread with its own mpv client, so
+// slow clients never hold up the plugin's event loop.
+//
+// requests:
+//   {"cmd":"log","level":"warn","module":"ffmpeg,vd"}  subscribe to logs ("level":"no" to stop)
+//   {"cmd":"observe","name":"pause"}                   subscribe to property changes
+//   {"cmd":"unobserve","name":"pause"}
+//   {"cmd":"get","name":"track-list"}                  one-shot property snapshot
+class Server {
+   public:
+    Server(mpv_handle *mpv, std::string address);
+    ~Server();
+
+    bool start();
+    void stop();
+    const std::string &error() const { return lastError; }
+
+   private:
+    static constexpr size_t MaxQueueBytes = 1024 * 1024;
+    static constexpr size_t MaxLineBytes = 64 * 1024;
+
+    struct Client {
+        socket_t fd;
+        std::string in;
+        std::deque<std::string> out;
+        size_t outOffset = 0;
+        size_t outBytes = 0;
+        size_t dropped = 0;
+        int logLevel = -1;
+        std::vector<std::string> modules;
+        std::set<std::string> props;
+        bool closed = false;
+    };
+
+    struct Observer {
+        uint64_t id;
+        int refs;
+    };
+
+    void run();
+    void wakeup();
+    void handleEvent(mpv_event *event);
+    void handleRequest(Client &client, const std::string &line);
+    void send(Client &client, std::string line);
+    void flush(Client &client);
+    void observe(Client &client, const std::string &name);
+    void unobserve(Client &client, const std::string &name);
+    void updateLogLevel();
+    bool fail(const std::string &msg);
+
+    mpv_handle *parent;
+    mpv_handle *mpv = nullptr;
+    std::string address;
+    std::string lastError;
+    std::thread thread;
+    std::atomic_bool running = false;
+
+    socket_t listenFd;
+    socket_t wakeFd;
+    std::vector<Client> clients;
+    std::map<std::string, Observer> observers;
+    uint64_t nextObserverId = 1;
+    int requestedLevel = -1;
+};